@@ -4,6 +4,7 @@
 #include "../libs/chesto/src/InputEvents.hpp"
 #include "../libs/chesto/src/RootDisplay.hpp"
 
+#include "../core/InstalledDB.hpp"
 #include "../gui/main.hpp"
 
 #include "Menu.hpp"
@@ -50,6 +51,10 @@ int console_main(RootDisplay* rootDisplay, InputEvents* input)
 			else if (menu->screen == REMOVING)
 				succeeded = menu->get->remove(target);
 
+			// libget changed the package folders directly, the gui reindexes them next launch
+			if (succeeded)
+				InstalledDB::invalidate(menu->get);
+
 			// change screen accordingly
 			if (succeeded)
 				menu->screen = INSTALL_SUCCESS;
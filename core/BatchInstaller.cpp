@@ -0,0 +1,130 @@
+#include "BatchInstaller.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "../libs/get/src/Utils.hpp"
+
+#include "PackageInstaller.hpp"
+#include "RangeDownload.hpp"
+#include "ZipStream.hpp"
+
+BatchInstaller::BatchInstaller(Get* get, std::vector<Package*> packages)
+	: get(get)
+	, packages(packages)
+	, received(new std::atomic<uint64_t>[packages.size()])
+	, sizes(new std::atomic<uint64_t>[packages.size()])
+{
+	for (size_t x = 0; x < packages.size(); x++)
+	{
+		zipPaths.push_back(get->mTmp_path + packages[x]->getPackageName() + ".zip");
+		received[x] = 0;
+		sizes[x] = 0;
+	}
+}
+
+int BatchInstaller::reportProgress()
+{
+	uint64_t now = 0, total = 0;
+	for (size_t x = 0; x < packages.size(); x++)
+	{
+		now += received[x];
+		total += sizes[x];
+	}
+
+	bytesNow = now;
+	bytesTotal = total;
+
+	if (onProgress && onProgress() != 0)
+		cancelled = true;
+
+	return cancelled ? 1 : 0;
+}
+
+void BatchInstaller::downloadWorker()
+{
+	while (true)
+	{
+		int index = nextDownload++;
+		if (index >= (int)packages.size())
+			return;
+
+		// once cancelled, the rest still get handed to the writer, as failures
+		bool ok = false;
+		if (!cancelled)
+		{
+			RangeDownload download(packages[index]->getZipUrl(), zipPaths[index]);
+			download.onProgress = [this, index](uint64_t now, uint64_t total) {
+				received[index] = now;
+				sizes[index] = total;
+				return (dropped && dropped(index)) ? 1 : reportProgress();
+			};
+
+			ok = download.run();
+		}
+
+		std::lock_guard<std::mutex> guard(readyLock);
+		ready.push_back({ index, ok });
+		readyChanged.notify_one();
+	}
+}
+
+std::vector<bool> BatchInstaller::run()
+{
+	std::vector<bool> results(packages.size(), false);
+
+	if (libget_status_callback)
+		libget_status_callback(STATUS_DOWNLOADING, 1, packages.size());
+
+	int workers = std::min<int>(BATCH_DOWNLOADS, packages.size());
+	std::vector<std::thread> downloaders;
+	for (int x = 0; x < workers; x++)
+		downloaders.emplace_back(&BatchInstaller::downloadWorker, this);
+
+	// this thread is the only one writing to the SD card, one package at a time
+	for (size_t done = 0; done < packages.size(); done++)
+	{
+		std::pair<int, bool> next;
+		{
+			std::unique_lock<std::mutex> guard(readyLock);
+			readyChanged.wait(guard, [this] { return !ready.empty(); });
+			next = ready.front();
+			ready.pop_front();
+		}
+
+		int index = next.first;
+		Package* package = packages[index];
+
+		if (!next.second || cancelled)
+		{
+			printf("--> Couldn't download %s for the batch\n", package->getPackageName().c_str());
+			continue;
+		}
+
+		// cancelled on its own after its download finished
+		if (dropped && dropped(index))
+		{
+			std::remove(zipPaths[index].c_str());
+			continue;
+		}
+
+		if (libget_status_callback)
+			libget_status_callback(STATUS_INSTALLING, applied + 1, packages.size());
+
+		// don't start writing an archive that isn't all there
+		std::string error;
+		if (!ZipStream::verifyArchive(zipPaths[index], &error))
+			printf("--> Downloaded %s is invalid: %s\n", package->getPackageName().c_str(), error.c_str());
+		else
+			results[index] = PackageInstaller::installFromFile(get, *package, zipPaths[index]);
+
+		std::remove(zipPaths[index].c_str());
+		applied++;
+		reportProgress();
+	}
+
+	for (auto& downloader : downloaders)
+		downloader.join();
+
+	return results;
+}
@@ -0,0 +1,63 @@
+#ifndef BATCHINSTALLER_H_
+#define BATCHINSTALLER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../libs/get/src/Get.hpp"
+
+// how many package zips download at the same time
+#define BATCH_DOWNLOADS 4
+
+// Installs several packages at once (eg. every pending update). Their zips download
+// concurrently into the temp folder, at most BATCH_DOWNLOADS at a time, and each one
+// is verified and extracted by the calling thread as soon as it's complete. That
+// single writer keeps the SD card seeing one package's sequential writes at a time,
+// while the total time approaches the largest download instead of their sum.
+class BatchInstaller
+{
+public:
+	BatchInstaller(Get* get, std::vector<Package*> packages);
+
+	// blocks until every package is installed or failed, returns which ones succeeded
+	std::vector<bool> run();
+
+	// summed over every download in the batch
+	std::atomic<uint64_t> bytesNow { 0 };
+	std::atomic<uint64_t> bytesTotal { 0 };
+	std::atomic<int> applied { 0 };
+
+	// called from any thread as progress is made, non-zero cancels the whole batch
+	std::function<int()> onProgress;
+
+	// called from any thread with a package's index, true cancels just that package
+	std::function<bool(int)> dropped;
+
+private:
+	void downloadWorker();
+	int reportProgress();
+
+	Get* get;
+	std::vector<Package*> packages;
+	std::vector<std::string> zipPaths;
+
+	// per package (downloaded, total), updated by the download threads
+	std::unique_ptr<std::atomic<uint64_t>[]> received;
+	std::unique_ptr<std::atomic<uint64_t>[]> sizes;
+
+	std::atomic<int> nextDownload { 0 };
+	std::atomic<bool> cancelled { false };
+
+	// downloads that finished (index, success), waiting for the writer
+	std::mutex readyLock;
+	std::condition_variable readyChanged;
+	std::deque<std::pair<int, bool>> ready;
+};
+
+#endif
@@ -0,0 +1,331 @@
+#include "ConnectionPool.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include "../libs/get/src/Utils.hpp"
+#include "../libs/chesto/src/DrawUtils.hpp"
+
+ConnectionPool* ConnectionPool::pool = nullptr;
+
+void ConnectionPool::init(const std::string& userAgent)
+{
+	if (!pool)
+		pool = new ConnectionPool(userAgent);
+}
+
+void ConnectionPool::quit()
+{
+	delete pool;
+	pool = nullptr;
+}
+
+ConnectionPool::ConnectionPool(const std::string& userAgent)
+	: userAgent(userAgent)
+{
+#ifndef NETWORK_MOCK
+	share = curl_share_init();
+	curl_share_setopt(share, CURLSHOPT_LOCKFUNC, ConnectionPool::lockShare);
+	curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, ConnectionPool::unlockShare);
+	curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+
+	// resolved hosts and tls sessions, curl can't share open connections between threads safely,
+	// so those stay with the handle that made them
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#endif
+}
+
+ConnectionPool::~ConnectionPool()
+{
+#ifndef NETWORK_MOCK
+	// anything still waiting for a slot gives up, and running transfers stop at their next progress callback
+	{
+		std::unique_lock<std::mutex> guard(slotLock);
+		closing = true;
+		slotChanged.notify_all();
+
+		// the locks and the share handle go away below, so nobody may still be using them
+		slotChanged.wait(guard, [this] {
+			int waiters = 0;
+			for (int x = 0; x < PRIORITY_COUNT; x++)
+				waiters += waiting[x];
+			return active.empty() && waiters == 0;
+		});
+	}
+
+	for (auto& handle : idle)
+		curl_easy_cleanup(handle.curl);
+	idle.clear();
+
+	curl_share_cleanup(share);
+#endif
+}
+
+#ifndef NETWORK_MOCK
+void ConnectionPool::lockShare(CURL* curl, curl_lock_data data, curl_lock_access access, void* userp)
+{
+	((ConnectionPool*)userp)->shareLocks[data].lock();
+}
+
+void ConnectionPool::unlockShare(CURL* curl, curl_lock_data data, void* userp)
+{
+	((ConnectionPool*)userp)->shareLocks[data].unlock();
+}
+
+size_t ConnectionPool::writeToString(char* data, size_t size, size_t nmemb, void* userp)
+{
+	((std::string*)userp)->append(data, size * nmemb);
+	return size * nmemb;
+}
+
+int ConnectionPool::forwardProgress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+	// the pool is shutting down
+	if (pool && pool->closing)
+		return 1;
+
+	// keep libget's progress callback working for requests that go through the pool
+	if (networking_callback)
+		return networking_callback(clientp, dltotal, dlnow, ultotal, ulnow);
+	return 0;
+}
+
+int ConnectionPool::checkPreempted(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+	// a nonzero return aborts the transfer, and frees its slot for the install
+	auto slot = (std::pair<ConnectionPool*, int>*)clientp;
+	return slot->first->preempted(slot->second) ? 1 : 0;
+}
+
+std::string ConnectionPool::hostOf(const std::string& url)
+{
+	size_t start = url.find("://");
+	start = start == std::string::npos ? 0 : start + 3;
+	return url.substr(start, url.find('/', start) - start);
+}
+
+bool ConnectionPool::admits(const std::string& host, int priority)
+{
+	if (closing || priority == PRIORITY_INSTALL)
+		return true;
+
+	// higher classes go first
+	for (int x = 0; x < priority; x++)
+		if (waiting[x] > 0)
+			return false;
+
+	auto count = perHost.find(host);
+	int shared = (int)active.size() - running[PRIORITY_INSTALL];
+	if ((count != perHost.end() && count->second >= POOL_HOST_CONNECTIONS) || shared >= POOL_MAX_CONNECTIONS)
+		return false;
+
+	// an install leaves just a little room for what's on screen, and none for speculative requests
+	if (running[PRIORITY_INSTALL] > 0)
+		return priority == PRIORITY_VISIBLE && shared < POOL_SHARED_WITH_INSTALL;
+
+	return true;
+}
+
+bool ConnectionPool::preempted(int priority)
+{
+	if (closing)
+		return true;
+
+	if (priority < PRIORITY_PREFETCH)
+		return false;
+
+	std::lock_guard<std::mutex> guard(slotLock);
+	if (closing || running[PRIORITY_INSTALL] > 0)
+		return true;
+
+	for (int x = 0; x < priority; x++)
+		if (waiting[x] > 0)
+			return true;
+
+	return false;
+}
+
+CURL* ConnectionPool::acquire(const std::string& url, int priority)
+{
+	std::string host = hostOf(url);
+
+	CURL* curl = nullptr;
+
+	{
+		std::unique_lock<std::mutex> guard(slotLock);
+		waiting[priority]++;
+		slotChanged.wait(guard, [&] { return admits(host, priority); });
+		waiting[priority]--;
+
+		// a class that stopped waiting may let a lower one through (or the destructor go on)
+		slotChanged.notify_all();
+		if (closing)
+			return nullptr;
+
+		{
+			// a handle that last talked to this host still has the connection open
+			std::lock_guard<std::mutex> idleGuard(idleLock);
+			auto handle = std::find_if(idle.rbegin(), idle.rend(), [&](const IdleHandle& handle) { return handle.host == host; });
+			if (handle == idle.rend() && !idle.empty())
+				handle = idle.rbegin();
+
+			if (handle != idle.rend())
+			{
+				curl = handle->curl;
+				idle.erase(std::next(handle).base());
+			}
+		}
+
+		if (!curl)
+			curl = curl_easy_init();
+
+		if (!curl)
+			return nullptr;
+
+		// counted before the lock is let go, so the pool can't shut down under this handle
+		active[curl] = { host, priority };
+		if (priority != PRIORITY_INSTALL)
+			perHost[host]++;
+		running[priority]++;
+	}
+
+	attach(curl);
+	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl, CURLOPT_USERAGENT, userAgent.c_str());
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
+
+	// stalled transfers give their slot up, sooner the less anyone is waiting on them
+	curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, priority == PRIORITY_INSTALL ? 1L : 256L);
+	curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, priority <= PRIORITY_VISIBLE ? 20L : 10L);
+
+#if defined(__WIIU__) || defined(WII) || defined(_3DS)
+	// these platforms don't ship a usable system CA store
+	curl_easy_setopt(curl, CURLOPT_CAINFO, RAMFS "res/cacert.pem");
+#endif
+
+	return curl;
+}
+
+void ConnectionPool::release(CURL* curl)
+{
+	if (!curl)
+		return;
+
+	// reset only clears the options, the connection stays open in the handle's own cache
+	curl_easy_reset(curl);
+
+	// all under the slot lock, once the last handle is gone the destructor frees everything
+	std::lock_guard<std::mutex> guard(slotLock);
+	std::string host;
+	auto slot = active.find(curl);
+	if (slot != active.end())
+	{
+		host = slot->second.host;
+		if (slot->second.priority != PRIORITY_INSTALL && --perHost[slot->second.host] <= 0)
+			perHost.erase(slot->second.host);
+		running[slot->second.priority]--;
+		active.erase(slot);
+	}
+
+	{
+		// the least recently used handle (and its connections) goes when there are too many
+		std::lock_guard<std::mutex> idleGuard(idleLock);
+		if (idle.size() >= POOL_IDLE_HANDLES)
+		{
+			curl_easy_cleanup(idle.front().curl);
+			idle.erase(idle.begin());
+		}
+		idle.push_back({ curl, host });
+	}
+
+	slotChanged.notify_all();
+}
+
+void ConnectionPool::attach(CURL* curl)
+{
+	curl_easy_setopt(curl, CURLOPT_SHARE, share);
+
+	// keep resolved hosts for the whole session, the CDNs don't move around
+	curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, -1L);
+}
+
+bool ConnectionPool::perform(CURL* curl, std::string* buffer, int priority)
+{
+	std::string discard;
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ConnectionPool::writeToString);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, buffer ? buffer : &discard);
+
+	// speculative requests don't move the progress bar, and step aside for higher priority work
+	std::pair<ConnectionPool*, int> slot(this, priority);
+	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+	if (priority >= PRIORITY_PREFETCH)
+	{
+		curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ConnectionPool::checkPreempted);
+		curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &slot);
+	}
+	else
+	{
+		curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ConnectionPool::forwardProgress);
+		curl_easy_setopt(curl, CURLOPT_XFERINFODATA, nullptr);
+	}
+
+	CURLcode res = curl_easy_perform(curl);
+	release(curl);
+
+	if (res == CURLE_ABORTED_BY_CALLBACK && priority >= PRIORITY_PREFETCH)
+	{
+		printf("--> Request put off for higher priority downloads\n");
+		return false;
+	}
+
+	if (res != CURLE_OK)
+	{
+		printf("--> Request failed: %s\n", curl_easy_strerror(res));
+		return false;
+	}
+
+	return true;
+}
+#endif
+
+bool ConnectionPool::installing()
+{
+#ifndef NETWORK_MOCK
+	std::lock_guard<std::mutex> guard(slotLock);
+	return running[PRIORITY_INSTALL] > 0;
+#else
+	return false;
+#endif
+}
+
+bool ConnectionPool::fetch(const std::string& url, std::string* buffer, int priority)
+{
+#ifndef NETWORK_MOCK
+	CURL* curl = acquire(url, priority);
+	if (!curl)
+		return false;
+
+	return perform(curl, buffer, priority);
+#else
+	return downloadFileToMemory(url, buffer);
+#endif
+}
+
+bool ConnectionPool::post(const std::string& url, const std::string& fields, std::string* buffer)
+{
+#ifndef NETWORK_MOCK
+	CURL* curl = acquire(url);
+	if (!curl)
+		return false;
+
+	// curl doesn't copy the fields, but they outlive the (blocking) perform
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, fields.c_str());
+	return perform(curl, buffer);
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,123 @@
+#ifndef CONNECTIONPOOL_H_
+#define CONNECTIONPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef NETWORK_MOCK
+#include <curl/curl.h>
+#endif
+
+// max number of idle easy handles kept around for reuse
+#define POOL_IDLE_HANDLES 8
+
+// priority classes for requests, lower numbers go first
+#define PRIORITY_INSTALL 0		// started by the user, never waits
+#define PRIORITY_VISIBLE 1		// something on screen right now
+#define PRIORITY_PREFETCH 2		// something the user might look at next
+#define PRIORITY_BACKGROUND 3	// refreshes nobody is waiting on
+#define PRIORITY_COUNT 4
+
+// transfers at once, per host and overall, not counting installs (which never wait, so a segmented
+// install to the cdn can't leave the ui's requests to the same host stuck behind it)
+#define POOL_HOST_CONNECTIONS 4
+#define POOL_MAX_CONNECTIONS 8
+
+// while an install downloads, this many visible requests can share the link with it
+#define POOL_SHARED_WITH_INSTALL 1
+
+// A process-wide pool of curl handles. Every handle handed out shares one DNS cache and
+// TLS session cache, and a request gets the idle handle that last talked to its host if
+// there is one, so it reuses that handle's open keep-alive connection instead of doing
+// another lookup + handshake. That covers this app's own requests; libget's repo fetches
+// and chesto's image downloads make their own handles.
+//
+// It also schedules them: acquire() waits until the request's priority class may run,
+// given the per-host and overall limits, and nothing waits on a higher class. While an
+// install downloads, prefetch and background requests are held back, and running ones are
+// cancelled (they'll be asked for again) so the install gets most of the bandwidth. Every
+// class gets a low-speed timeout, so a stalled transfer gives its slot up.
+class ConnectionPool
+{
+public:
+	static ConnectionPool* pool;
+
+	static void init(const std::string& userAgent);
+	static void quit();
+
+	// blocking helpers, for small documents (json, manifests, feedback)
+	bool fetch(const std::string& url, std::string* buffer, int priority = PRIORITY_VISIBLE);
+	bool post(const std::string& url, const std::string& fields, std::string* buffer = nullptr);
+
+	// whether an install is downloading, for downloads outside the pool (chesto's image
+	// queue) that should wait for it the way prefetch and background requests do
+	bool installing();
+
+#ifndef NETWORK_MOCK
+	// take a handle configured with the shared caches and our default options, once the
+	// scheduler lets this priority class run (nullptr if the pool is shutting down)
+	CURL* acquire(const std::string& url, int priority = PRIORITY_VISIBLE);
+
+	// give a handle back (its connection stays open for the next request to that host) and its slot up
+	void release(CURL* curl);
+
+	// whether a transfer of this class should stop for higher priority work
+	bool preempted(int priority);
+#endif
+
+private:
+	ConnectionPool(const std::string& userAgent);
+	~ConnectionPool();
+
+	std::string userAgent;
+
+#ifndef NETWORK_MOCK
+	static void lockShare(CURL* curl, curl_lock_data data, curl_lock_access access, void* userp);
+	static void unlockShare(CURL* curl, curl_lock_data data, void* userp);
+	static size_t writeToString(char* data, size_t size, size_t nmemb, void* userp);
+	static int forwardProgress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+	static int checkPreempted(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
+	bool perform(CURL* curl, std::string* buffer, int priority = PRIORITY_VISIBLE);
+
+	// point a handle at the shared caches
+	void attach(CURL* curl);
+
+	static std::string hostOf(const std::string& url);
+	bool admits(const std::string& host, int priority);
+
+	CURLSH* share = nullptr;
+	std::mutex shareLocks[CURL_LOCK_DATA_LAST];
+
+	// released handles, oldest first, with the host their open connection is to
+	struct IdleHandle
+	{
+		CURL* curl;
+		std::string host;
+	};
+
+	std::mutex idleLock;
+	std::vector<IdleHandle> idle;
+
+	struct Slot
+	{
+		std::string host;
+		int priority;
+	};
+
+	// every handle that's been acquired and not released yet
+	std::mutex slotLock;
+	std::condition_variable slotChanged;
+	std::unordered_map<CURL*, Slot> active;
+	std::unordered_map<std::string, int> perHost;	// without installs
+	int running[PRIORITY_COUNT] = {};
+	int waiting[PRIORITY_COUNT] = {};
+	std::atomic<bool> closing { false };
+#endif
+};
+
+#endif
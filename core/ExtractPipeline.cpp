@@ -0,0 +1,345 @@
+#include "ExtractPipeline.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#include "../libs/get/src/Utils.hpp"
+
+#include "StreamHash.hpp"
+
+#define METHOD_STORED 0
+
+ExtractPipeline::ExtractPipeline(int inflateThreads)
+	: threaded(inflateThreads > 0)
+	, block(PIPELINE_BLOCK)
+{
+	for (int x = 0; x < inflateThreads; x++)
+		inflaters.emplace_back(&ExtractPipeline::inflateWorker, this);
+
+	if (threaded)
+		writer = std::thread(&ExtractPipeline::writerWorker, this);
+}
+
+ExtractPipeline::~ExtractPipeline()
+{
+	{
+		// whatever hasn't been written yet is dropped, the install failed anyway
+		std::lock_guard<std::mutex> guard(lock);
+		inflateJobs.clear();
+		writeJobs.clear();
+		stopping = true;
+	}
+	changed.notify_all();
+
+	for (auto& inflater : inflaters)
+		inflater.join();
+	if (writer.joinable())
+		writer.join();
+
+	if (out)
+		closeFile(false);
+}
+
+int ExtractPipeline::defaultThreads()
+{
+	unsigned cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 0;
+}
+
+bool ExtractPipeline::fail(const std::string& reason)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (!failed)
+		error = reason;
+	failed = true;
+	return false;
+}
+
+bool ExtractPipeline::submit(const std::string& path, uint16_t method, uint32_t crc, uint64_t size, std::string&& compressed)
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	// the download waits here while the inflate workers are behind
+	changed.wait(guard, [this] { return failed || stopping || inflateBytes < PIPELINE_MAX_BYTES; });
+	if (failed || stopping)
+		return false;
+
+	inflateBytes += compressed.size();
+	inflateJobs.push_back({ path, method, crc, size, std::move(compressed) });
+	guard.unlock();
+
+	changed.notify_all();
+	return true;
+}
+
+bool ExtractPipeline::open(const std::string& path)
+{
+	// a false here only makes the zip skip the entry, so the failure is also kept for flush()
+	if (!threaded)
+	{
+		makeDirectory(path.substr(0, path.rfind('/')));
+		return openFile(path) || fail("couldn't open " + path + " for writing");
+	}
+
+	return queueWrite({ WRITE_OPEN, path });
+}
+
+bool ExtractPipeline::write(const char* data, size_t len)
+{
+	if (!threaded)
+		return writeData(data, len) || fail("couldn't write to the SD card");
+
+	return queueWrite({ WRITE_DATA, "", std::string(data, len) });
+}
+
+bool ExtractPipeline::close(bool valid)
+{
+	if (!threaded)
+		return closeFile(valid) || fail("couldn't write to the SD card");
+
+	WriteJob job { WRITE_CLOSE };
+	job.valid = valid;
+	return queueWrite(std::move(job));
+}
+
+bool ExtractPipeline::flush()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	changed.wait(guard, [this] { return failed || (inflateJobs.empty() && writeJobs.empty() && busy == 0); });
+	return !failed;
+}
+
+bool ExtractPipeline::queueWrite(WriteJob&& job)
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	// only the writer drains this, so waiting on it can't deadlock
+	changed.wait(guard, [this] { return failed || stopping || writeBytes < PIPELINE_MAX_BYTES; });
+	if (failed || stopping)
+		return false;
+
+	writeBytes += job.data.size();
+	writeJobs.push_back(std::move(job));
+	guard.unlock();
+
+	changed.notify_all();
+	return true;
+}
+
+void ExtractPipeline::inflateWorker()
+{
+	while (true)
+	{
+		InflateJob job;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [this] { return stopping || !inflateJobs.empty(); });
+			if (inflateJobs.empty())
+				return;
+
+			job = std::move(inflateJobs.front());
+			inflateJobs.pop_front();
+			busy++;
+		}
+
+		size_t compSize = job.compressed.size();
+
+		std::string data;
+		if (inflateEntry(job, &data))
+			queueWrite({ WRITE_FILE, job.path, std::move(data) });
+		else
+			fail("corrupt entry for " + job.path);
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			inflateBytes -= compSize;
+			busy--;
+		}
+		changed.notify_all();
+	}
+}
+
+bool ExtractPipeline::inflateEntry(InflateJob& job, std::string* out)
+{
+	if (job.method == METHOD_STORED)
+		out->swap(job.compressed);
+	else
+	{
+		out->resize(job.size);
+
+		z_stream inflater = {};
+		if (inflateInit2(&inflater, -MAX_WBITS) != Z_OK)
+			return false;
+
+		inflater.next_in = (Bytef*)job.compressed.data();
+		inflater.avail_in = job.compressed.size();
+		inflater.next_out = (Bytef*)&(*out)[0];
+		inflater.avail_out = job.size;
+
+		int ret = inflate(&inflater, Z_FINISH);
+		inflateEnd(&inflater);
+
+		if (ret != Z_STREAM_END || inflater.total_out != job.size)
+			return false;
+	}
+
+	return out->size() == job.size && StreamHash::updateCrc(0, out->data(), out->size()) == job.crc;
+}
+
+void ExtractPipeline::writerWorker()
+{
+	while (true)
+	{
+		std::deque<WriteJob> batch;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [this] { return stopping || !writeJobs.empty(); });
+			if (writeJobs.empty())
+				return;
+
+			// take everything that's waiting, small files get written back to back
+			batch.swap(writeJobs);
+			busy++;
+		}
+
+		// create the directories for the whole batch before writing any of it
+		for (auto& job : batch)
+			if (job.kind == WRITE_FILE || job.kind == WRITE_OPEN)
+				makeDirectory(job.path.substr(0, job.path.rfind('/')));
+
+		size_t bytes = 0;
+		bool ok = true;
+		for (auto& job : batch)
+		{
+			bytes += job.data.size();
+			ok = ok && runWrite(job);
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			writeBytes -= bytes;
+			busy--;
+		}
+
+		if (!ok)
+			fail("couldn't write to the SD card");
+
+		changed.notify_all();
+	}
+}
+
+bool ExtractPipeline::runWrite(WriteJob& job)
+{
+	switch (job.kind)
+	{
+		case WRITE_FILE:
+			return writeWhole(job.path, job.data);
+		case WRITE_OPEN:
+			return openFile(job.path);
+		case WRITE_DATA:
+			return writeData(job.data.data(), job.data.size());
+		case WRITE_CLOSE:
+			return closeFile(job.valid);
+	}
+
+	return false;
+}
+
+bool ExtractPipeline::writeWhole(const std::string& path, const std::string& data)
+{
+	// a streamed file may be open at the same time, so this one gets its own handle
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		printf("--> Couldn't open %s for writing\n", path.c_str());
+		return false;
+	}
+
+	// already in memory, so it goes out in one write
+	setvbuf(file, nullptr, _IONBF, 0);
+	bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok)
+		std::remove(path.c_str());
+
+	return ok;
+}
+
+bool ExtractPipeline::openFile(const std::string& path)
+{
+	outPath = path;
+	out = fopen(path.c_str(), "wb");
+	if (!out)
+	{
+		printf("--> Couldn't open %s for writing\n", path.c_str());
+		return false;
+	}
+
+	// we do our own block sized buffering
+	setvbuf(out, nullptr, _IONBF, 0);
+	blockUsed = 0;
+	return true;
+}
+
+bool ExtractPipeline::writeData(const char* data, size_t len)
+{
+	if (!out)
+		return false;
+
+	while (len > 0)
+	{
+		// big enough chunks skip the copy, as long as we're on a block boundary
+		if (blockUsed == 0 && len >= PIPELINE_BLOCK)
+		{
+			size_t whole = len - len % PIPELINE_BLOCK;
+			if (fwrite(data, 1, whole, out) != whole)
+				return false;
+			data += whole;
+			len -= whole;
+			continue;
+		}
+
+		size_t take = std::min(len, PIPELINE_BLOCK - blockUsed);
+		memcpy(&block[blockUsed], data, take);
+		blockUsed += take;
+		data += take;
+		len -= take;
+
+		if (blockUsed == PIPELINE_BLOCK)
+		{
+			if (fwrite(block.data(), 1, PIPELINE_BLOCK, out) != PIPELINE_BLOCK)
+				return false;
+			blockUsed = 0;
+		}
+	}
+
+	return true;
+}
+
+bool ExtractPipeline::closeFile(bool valid)
+{
+	if (!out)
+		return false;
+
+	bool ok = blockUsed == 0 || fwrite(block.data(), 1, blockUsed, out) == blockUsed;
+	ok = fclose(out) == 0 && ok;
+	out = nullptr;
+	blockUsed = 0;
+
+	// don't leave a corrupt file behind
+	if (!valid)
+		std::remove(outPath.c_str());
+
+	return ok;
+}
+
+void ExtractPipeline::makeDirectory(const std::string& path)
+{
+	if (createdDirs.count(path))
+		return;
+
+	mkpath(path);
+	createdDirs.insert(path);
+}
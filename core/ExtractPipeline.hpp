@@ -0,0 +1,119 @@
+#ifndef EXTRACTPIPELINE_H_
+#define EXTRACTPIPELINE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// files are written to the SD card in blocks of this size (a multiple of its cluster size)
+#define PIPELINE_BLOCK 0x40000
+
+// entries up to this (inflated) size are inflated whole by a worker, bigger ones stream through
+#define PARALLEL_ENTRY_MAX (4 * 1024 * 1024)
+
+// how much data can wait in each stage before whoever is feeding it has to wait
+#if defined(_3DS) || defined(WII)
+#define PIPELINE_MAX_BYTES (4 * 1024 * 1024)
+#else
+#define PIPELINE_MAX_BYTES (16 * 1024 * 1024)
+#endif
+
+// Splits writing extracted files into stages: inflate workers decompress whole entries
+// in parallel, and a single writer thread puts everything on the SD card in large block
+// sized writes, creating the directories for each batch of files it picks up at once.
+// With no inflate threads (single core targets), everything is written inline instead.
+class ExtractPipeline
+{
+public:
+	ExtractPipeline(int inflateThreads = defaultThreads());
+	~ExtractPipeline();
+
+	// one inflate worker per core, leaving one for the download (none on a single core)
+	static int defaultThreads();
+
+	bool parallel() const { return threaded; }
+
+	// a whole compressed entry, inflated and crc checked by a worker, then written
+	bool submit(const std::string& path, uint16_t method, uint32_t crc, uint64_t size, std::string&& compressed);
+
+	// a file inflated by the caller, written in order as it arrives
+	bool open(const std::string& path);
+	bool write(const char* data, size_t len);
+	bool close(bool valid);
+
+	// waits until everything handed over is on the SD card, false if any of it failed
+	bool flush();
+
+	std::string error;
+
+private:
+	enum WriteKind
+	{
+		WRITE_FILE,
+		WRITE_OPEN,
+		WRITE_DATA,
+		WRITE_CLOSE
+	};
+
+	struct InflateJob
+	{
+		std::string path;
+		uint16_t method;
+		uint32_t crc;
+		uint64_t size;
+		std::string compressed;
+	};
+
+	struct WriteJob
+	{
+		WriteKind kind;
+		std::string path;
+		std::string data;
+		bool valid = true;
+	};
+
+	void inflateWorker();
+	void writerWorker();
+	bool queueWrite(WriteJob&& job);
+	bool fail(const std::string& reason);
+
+	static bool inflateEntry(InflateJob& job, std::string* out);
+
+	// the disk side, run by the writer thread (or inline without threads)
+	bool runWrite(WriteJob& job);
+	bool writeWhole(const std::string& path, const std::string& data);
+	bool openFile(const std::string& path);
+	bool writeData(const char* data, size_t len);
+	bool closeFile(bool valid);
+	void makeDirectory(const std::string& path);
+
+	bool threaded;
+
+	std::mutex lock;
+	std::condition_variable changed;
+	std::deque<InflateJob> inflateJobs;
+	std::deque<WriteJob> writeJobs;
+	size_t inflateBytes = 0;
+	size_t writeBytes = 0;
+	int busy = 0;
+	bool stopping = false;
+	bool failed = false;
+
+	std::vector<std::thread> inflaters;
+	std::thread writer;
+
+	// the file being streamed to, only touched by the writer
+	FILE* out = nullptr;
+	std::string outPath;
+	std::vector<char> block;
+	size_t blockUsed = 0;
+	std::unordered_set<std::string> createdDirs;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "IndexDigests.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "rapidjson/document.h"
+
+#include "ConnectionPool.hpp"
+#include "OperationQueue.hpp"
+
+std::mutex IndexDigests::lock;
+bool IndexDigests::loaded = false;
+std::unordered_map<std::string, PackageDigest> IndexDigests::digests;
+
+PackageDigest IndexDigests::lookup(Get* get, const std::string& packageName)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	if (!loaded)
+		loaded = load(get);
+
+	auto digest = digests.find(packageName);
+	return digest != digests.end() ? digest->second : PackageDigest();
+}
+
+void IndexDigests::invalidate()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	loaded = false;
+}
+
+bool IndexDigests::load(Get* get)
+{
+	std::vector<std::string> urls;
+	{
+		std::lock_guard<std::mutex> getGuard(OperationQueue::getLock);
+		for (auto repo : get->getRepos())
+			if (repo->isEnabled() && repo->getType() == "get")
+				urls.push_back(repo->getUrl() + "/repo.json");
+	}
+
+	// a repo that can't be fetched keeps what it had, and is tried again on the next lookup
+	bool complete = true;
+	std::unordered_map<std::string, PackageDigest> fresh;
+	for (auto& url : urls)
+	{
+		std::string data;
+		if (!ConnectionPool::pool->fetch(url, &data, PRIORITY_INSTALL))
+		{
+			printf("--> Couldn't fetch %s for package digests\n", url.c_str());
+			complete = false;
+			continue;
+		}
+
+		rapidjson::Document index;
+		index.Parse(data.c_str());
+		if (index.HasParseError() || !index.HasMember("packages") || !index["packages"].IsArray())
+		{
+			complete = false;
+			continue;
+		}
+
+		for (auto& entry : index["packages"].GetArray())
+		{
+			if (!entry.IsObject() || !entry.HasMember("name") || !entry["name"].IsString())
+				continue;
+
+			PackageDigest digest;
+
+			if (entry.HasMember("sha256") && entry["sha256"].IsString())
+			{
+				digest.sha256 = entry["sha256"].GetString();
+				std::transform(digest.sha256.begin(), digest.sha256.end(), digest.sha256.begin(), ::tolower);
+			}
+
+			if (entry.HasMember("crc32") && entry["crc32"].IsString())
+			{
+				digest.crc = strtoul(entry["crc32"].GetString(), nullptr, 16);
+				digest.hasCrc = true;
+			}
+
+			if (digest.known())
+				fresh[entry["name"].GetString()] = digest;
+		}
+	}
+
+	if (complete)
+		digests.swap(fresh);
+	else
+		for (auto& digest : fresh)
+			digests[digest.first] = digest.second;
+
+	printf("--> Loaded zip digests for %zu packages\n", digests.size());
+	return complete;
+}
@@ -0,0 +1,42 @@
+#ifndef INDEXDIGESTS_H_
+#define INDEXDIGESTS_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "../libs/get/src/Get.hpp"
+
+// what a repo index publishes about a package's zip, either field may be missing
+struct PackageDigest
+{
+	std::string sha256;
+	uint32_t crc = 0;
+	bool hasCrc = false;
+
+	bool known() const { return hasCrc || !sha256.empty(); }
+};
+
+// Digests of package zips, from the optional "sha256" and "crc32" (hex) fields of each
+// package in the repo indexes. The indexes are fetched the first time a digest is needed,
+// from whichever thread asks for it, and again after every package status reload (libget
+// refetches the indexes then too, but doesn't keep these fields).
+class IndexDigests
+{
+public:
+	static PackageDigest lookup(Get* get, const std::string& packageName);
+
+	// the indexes were reloaded, the next lookup fetches the digests again
+	static void invalidate();
+
+private:
+	// false if a repo couldn't be fetched, so the next lookup tries again
+	static bool load(Get* get);
+
+	static std::mutex lock;
+	static bool loaded;
+	static std::unordered_map<std::string, PackageDigest> digests;
+};
+
+#endif
@@ -0,0 +1,383 @@
+#include "InstallJournal.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sys/stat.h>
+#include <unordered_set>
+
+#include "../libs/get/src/Utils.hpp"
+
+#include "InstalledDB.hpp"
+#include "PackageRemover.hpp"
+
+static bool exists(const std::string& path)
+{
+	struct stat buffer;
+	return stat(path.c_str(), &buffer) == 0;
+}
+
+static bool endsWith(const std::string& text, const std::string& suffix)
+{
+	return text.size() > suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+InstallJournal::InstallJournal(Get* get, const std::string& packageName)
+	: stageDir(folder(get) + packageName + ".stage/")
+	, journalPath(folder(get) + packageName + ".journal")
+	, previousDir(folder(get) + packageName + ".previous/")
+	, infoPath(infoPathFor(get, packageName))
+{
+	// whatever an earlier, failed attempt left behind
+	clearFolder(stageDir);
+	mkpath(stageDir);
+}
+
+InstallJournal::~InstallJournal()
+{
+	if (!done)
+		discard();
+}
+
+std::string InstallJournal::folder(Get* get)
+{
+	return get->mTmp_path + "transactions/";
+}
+
+std::string InstallJournal::infoPathFor(Get* get, const std::string& packageName)
+{
+	return get->mPkg_path + packageName + "/info.json";
+}
+
+bool InstallJournal::keepPrevious(const std::string& previousDir, const std::string& infoPath, const std::string& journal, const std::vector<Entry>& entries)
+{
+	// only an install over an installed version (its info.json was moved aside) has one to go back to
+	for (auto& entry : entries)
+		if (entry.target == infoPath && exists(previousDir + entry.name))
+			return std::rename(journal.c_str(), (previousDir + "journal").c_str()) == 0;
+
+	std::remove(journal.c_str());
+	clearFolder(previousDir);
+	return false;
+}
+
+std::string InstallJournal::stage(const std::string& finalPath)
+{
+	// staged files are numbered, so the stage never needs any folders of its own
+	std::string name = std::to_string(entries.size());
+	entries.push_back({ 'F', name, finalPath });
+	return stageDir + name;
+}
+
+void InstallJournal::remove(const std::string& finalPath)
+{
+	entries.push_back({ 'D', "d" + std::to_string(entries.size()), finalPath });
+}
+
+bool InstallJournal::commit()
+{
+	// the version this commit replaces becomes the new previous one
+	clearFolder(previousDir);
+	mkpath(previousDir);
+
+	// once the journal exists under its real name, the install will complete even after a power loss
+	std::string tmpPath = journalPath + ".tmp";
+	if (!writeJournal(tmpPath, entries) || std::rename(tmpPath.c_str(), journalPath.c_str()) != 0)
+	{
+		printf("--> Couldn't write the install journal %s\n", journalPath.c_str());
+		std::remove(tmpPath.c_str());
+		discard();
+		return false;
+	}
+
+	// if a move fails the journal and stage stay, and the next launch finishes what's left
+	done = true;
+	if (!apply(stageDir, previousDir, entries))
+	{
+		printf("--> Couldn't move every file into place, the install will be finished on the next launch\n");
+		return false;
+	}
+
+	// kept as the list of what a rollback has to undo
+	keepPrevious(previousDir, infoPath, journalPath, entries);
+	clearFolder(stageDir);
+	return true;
+}
+
+void InstallJournal::discard()
+{
+	clearFolder(stageDir);
+	done = true;
+}
+
+bool InstallJournal::readJournal(const std::string& path, std::vector<Entry>* entries)
+{
+	std::ifstream journal(path);
+	if (!journal.is_open())
+		return false;
+
+	// lines look like "F 12 sdmc:/switch/appstore/appstore.nro"
+	std::string line;
+	while (std::getline(journal, line))
+	{
+		size_t space = line.find(' ', 2);
+		if (line.size() < 4 || line[1] != ' ' || space == std::string::npos)
+			continue;
+
+		entries->push_back({ line[0], line.substr(2, space - 2), line.substr(space + 1) });
+	}
+
+	return true;
+}
+
+bool InstallJournal::writeJournal(const std::string& path, const std::vector<Entry>& entries)
+{
+	FILE* journal = fopen(path.c_str(), "wb");
+	if (!journal)
+		return false;
+
+	bool ok = true;
+	for (auto& entry : entries)
+		ok = ok && fprintf(journal, "%c %s %s\n", entry.op, entry.name.c_str(), entry.target.c_str()) > 0;
+
+	return fclose(journal) == 0 && ok;
+}
+
+bool InstallJournal::apply(const std::string& stageDir, const std::string& previousDir, const std::vector<Entry>& entries)
+{
+	// every step checks what's already done, so replaying a journal after a power loss is safe
+	std::unordered_set<std::string> createdDirs;
+	bool moved = true;
+
+	for (auto& entry : entries)
+	{
+		std::string staged = stageDir + entry.name;
+		std::string previous = previousDir + entry.name;
+
+		// a staged file that's gone was already moved into place
+		if (entry.op == 'F' && !exists(staged))
+			continue;
+
+		if (exists(entry.target))
+		{
+			if (exists(previous))
+				std::remove(entry.target.c_str());
+			else
+				std::rename(entry.target.c_str(), previous.c_str());
+		}
+
+		if (entry.op != 'F')
+			continue;
+
+		std::string dir = entry.target.substr(0, entry.target.rfind('/'));
+		if (createdDirs.insert(dir).second)
+			mkpath(dir);
+
+		if (std::rename(staged.c_str(), entry.target.c_str()) != 0)
+		{
+			printf("--> Couldn't move %s into place\n", entry.target.c_str());
+			moved = false;
+		}
+	}
+
+	return moved;
+}
+
+void InstallJournal::clearFolder(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::remove_all(path, error);
+}
+
+std::vector<std::string> InstallJournal::recover(Get* get)
+{
+	std::vector<std::string> recovered;
+	std::string dir = folder(get);
+	std::error_code error;
+	if (!std::filesystem::is_directory(dir, error))
+		return recovered;
+
+	std::vector<std::string> names;
+	for (auto& file : std::filesystem::directory_iterator(dir, error))
+		names.push_back(file.path().filename().string());
+
+	for (auto& name : names)
+	{
+		// a journal that was never renamed into place means the install hadn't committed yet
+		if (endsWith(name, ".journal.tmp"))
+			std::remove((dir + name).c_str());
+
+		if (!endsWith(name, ".journal"))
+			continue;
+
+		std::string package = name.substr(0, name.size() - 8);
+		std::string stageDir = dir + package + ".stage/";
+		std::string previousDir = dir + package + ".previous/";
+
+		// roll forward
+		std::vector<Entry> entries;
+		readJournal(dir + name, &entries);
+		mkpath(previousDir);
+		recovered.push_back(package);
+		if (!apply(stageDir, previousDir, entries))
+		{
+			printf("--> Couldn't finish the interrupted install of %s, trying again next launch\n", package.c_str());
+			continue;
+		}
+
+		keepPrevious(previousDir, infoPathFor(get, package), dir + name, entries);
+		clearFolder(stageDir);
+		printf("--> Finished the interrupted install of %s\n", package.c_str());
+	}
+
+	// roll back everything that was still staging, none of it reached its real location
+	// (a stage whose journal couldn't be finished above is kept for the next try)
+	for (auto& name : names)
+		if (endsWith(name, ".stage") && !exists(dir + name.substr(0, name.size() - 6) + ".journal"))
+			clearFolder(dir + name);
+
+	return recovered;
+}
+
+std::vector<std::string> InstallJournal::finishRemovals(Get* get)
+{
+	std::vector<std::string> packages;
+	std::string dir = folder(get);
+	std::error_code error;
+	if (!std::filesystem::is_directory(dir, error))
+		return packages;
+
+	for (auto& file : std::filesystem::directory_iterator(dir, error))
+	{
+		std::string name = file.path().filename().string();
+		if (endsWith(name, ".removing"))
+			packages.push_back(name.substr(0, name.size() - 9));
+	}
+
+	for (auto& package : packages)
+	{
+		// removing is safe to repeat, it skips files that are already gone
+		auto installed = get->lookup(package);
+		if (installed && installed->getStatus() != GET)
+		{
+			printf("--> Finishing the interrupted removal of %s\n", package.c_str());
+			if (!PackageRemover::remove(get, package) && !PackageRemover::tracked(get, package))
+				get->remove(*installed);
+		}
+
+		endRemoval(get, package);
+	}
+
+	return packages;
+}
+
+void InstallJournal::beginRemoval(Get* get, const std::string& packageName, const std::vector<std::string>& keep)
+{
+	mkpath(folder(get));
+	std::ofstream marker(folder(get) + packageName + ".removing");
+
+	if (keep.empty())
+		return;
+
+	// listed before anything moves, so endRemoval can always put them back
+	std::string keepDir = folder(get) + packageName + ".keep/";
+	mkpath(keepDir);
+
+	std::vector<Entry> kept;
+	for (auto& path : keep)
+		kept.push_back({ 'K', std::to_string(kept.size()), ROOT_PATH + path });
+
+	if (!writeJournal(keepDir + "list", kept))
+		return;
+
+	for (auto& entry : kept)
+		std::rename(entry.target.c_str(), (keepDir + entry.name).c_str());
+}
+
+void InstallJournal::endRemoval(Get* get, const std::string& packageName)
+{
+	// a removed package has no version to go back to
+	clearFolder(folder(get) + packageName + ".previous/");
+
+	std::string keepDir = folder(get) + packageName + ".keep/";
+	std::vector<Entry> kept;
+	if (readJournal(keepDir + "list", &kept))
+	{
+		for (auto& entry : kept)
+		{
+			if (!exists(keepDir + entry.name))
+				continue;
+
+			mkpath(entry.target.substr(0, entry.target.rfind('/')));
+			if (std::rename((keepDir + entry.name).c_str(), entry.target.c_str()) != 0)
+				printf("--> Couldn't put back %s\n", entry.target.c_str());
+		}
+		clearFolder(keepDir);
+	}
+
+	std::remove((folder(get) + packageName + ".removing").c_str());
+}
+
+bool InstallJournal::ownedByOthers(const std::string& packageName, const std::string& target)
+{
+	std::string root = ROOT_PATH;
+	if (!InstalledDB::db || target.compare(0, root.size(), root) != 0)
+		return false;
+
+	for (auto& owner : InstalledDB::db->owners(target.substr(root.size())))
+		if (owner != packageName)
+			return true;
+
+	return false;
+}
+
+bool InstallJournal::hasPrevious(Get* get, const std::string& packageName)
+{
+	return exists(folder(get) + packageName + ".previous/journal");
+}
+
+bool InstallJournal::rollback(Get* get, const std::string& packageName)
+{
+	InstallJournal journal(get, packageName);
+
+	std::vector<Entry> installed;
+	if (!readJournal(journal.previousDir + "journal", &installed))
+		return false;
+
+	// the previous files become the stage: what they replaced goes back, what the install added goes away
+	std::unordered_set<std::string> names;
+	for (auto& entry : installed)
+		if (exists(journal.previousDir + entry.name))
+		{
+			journal.entries.push_back({ 'F', entry.name, entry.target });
+			names.insert(entry.name);
+		}
+
+	int next = 0;
+	for (auto& entry : installed)
+	{
+		if (entry.op != 'F' || exists(journal.previousDir + entry.name))
+			continue;
+
+		// files other packages installed too stay, the same as when removing this package
+		if (ownedByOthers(packageName, entry.target))
+			continue;
+
+		std::string name;
+		do
+			name = "d" + std::to_string(next++);
+		while (names.count(name));
+
+		journal.entries.push_back({ 'D', name, entry.target });
+	}
+
+	std::remove((journal.previousDir + "journal").c_str());
+	clearFolder(journal.stageDir);
+	if (std::rename(journal.previousDir.substr(0, journal.previousDir.size() - 1).c_str(), journal.stageDir.substr(0, journal.stageDir.size() - 1).c_str()) != 0)
+		return false;
+
+	// committed like any install, so the version being replaced can be rolled back to in turn
+	printf("--> Rolling %s back to its previous version\n", packageName.c_str());
+	return journal.commit();
+}
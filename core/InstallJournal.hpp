@@ -0,0 +1,85 @@
+#ifndef INSTALLJOURNAL_H_
+#define INSTALLJOURNAL_H_
+
+#include <string>
+#include <vector>
+
+#include "../libs/get/src/Get.hpp"
+
+// Makes an install all-or-nothing on the SD card. Files are extracted into a staging
+// folder first, and only once everything is there does commit() write a journal of
+// the renames that put them in place (and of files to delete). The files they replace
+// are moved aside as the package's previous version, so going back to it is a rename too.
+//
+// If the console powers off mid-install, recover() at the next launch replays any
+// journal that was written (roll forward) and throws away stages that never got one
+// (roll back), which only costs a few renames instead of a reset and full rescan.
+class InstallJournal
+{
+public:
+	InstallJournal(Get* get, const std::string& packageName);
+	~InstallJournal();
+
+	// a path in the staging folder, that will replace finalPath on commit
+	std::string stage(const std::string& finalPath);
+
+	// finalPath is removed on commit (kept with the previous version)
+	void remove(const std::string& finalPath);
+
+	// moves everything staged into place, after this the install is done (if a file can't be
+	// moved it returns false, and the next launch's recover() finishes the job)
+	bool commit();
+
+	// drops everything staged, nothing outside of it was touched
+	void discard();
+
+	// finishes or undoes whatever was interrupted, call before the package statuses are loaded,
+	// returns the packages whose files changed
+	static std::vector<std::string> recover(Get* get);
+
+	// reruns removals that were interrupted, call once the package statuses are loaded
+	static std::vector<std::string> finishRemovals(Get* get);
+
+	// bracket a removal, so one that was cut short is finished on the next launch, the kept
+	// paths (relative to ROOT_PATH, eg. files other packages share) are moved aside and put back after
+	static void beginRemoval(Get* get, const std::string& packageName, const std::vector<std::string>& keep = {});
+	static void endRemoval(Get* get, const std::string& packageName);
+
+	// whether this package's last install replaced an installed version, whose files are still around
+	static bool hasPrevious(Get* get, const std::string& packageName);
+
+	// swaps the previous version's files back in, and drops the ones it didn't have (unless another package has them too)
+	static bool rollback(Get* get, const std::string& packageName);
+
+private:
+	struct Entry
+	{
+		char op;			// F: staged file replaces target, D: target deleted, K: target kept through a removal
+		std::string name;	// file name in the stage and previous folders
+		std::string target;
+	};
+
+	static std::string folder(Get* get);
+	static bool readJournal(const std::string& path, std::vector<Entry>* entries);
+	static bool writeJournal(const std::string& path, const std::vector<Entry>& entries);
+
+	// false if any staged file couldn't be moved into place
+	static bool apply(const std::string& stageDir, const std::string& previousDir, const std::vector<Entry>& entries);
+
+	// moves an applied journal into previousDir if the install replaced an installed version,
+	// otherwise there's nothing to roll back to and both go
+	static bool keepPrevious(const std::string& previousDir, const std::string& infoPath, const std::string& journal, const std::vector<Entry>& entries);
+
+	static std::string infoPathFor(Get* get, const std::string& packageName);
+	static bool ownedByOthers(const std::string& packageName, const std::string& target);
+	static void clearFolder(const std::string& path);
+
+	std::string stageDir;
+	std::string journalPath;
+	std::string previousDir;
+	std::string infoPath;
+	std::vector<Entry> entries;
+	bool done = false;
+};
+
+#endif
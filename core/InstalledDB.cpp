@@ -0,0 +1,413 @@
+#include "InstalledDB.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "rapidjson/document.h"
+
+#include "StreamHash.hpp"
+
+#define RECORD_PUT 'P'
+#define RECORD_ERASE 'X'
+
+InstalledDB* InstalledDB::db = nullptr;
+
+void InstalledDB::init(Get* get)
+{
+	if (!db)
+		db = new InstalledDB(get);
+}
+
+void InstalledDB::quit()
+{
+	delete db;
+	db = nullptr;
+}
+
+InstalledDB::InstalledDB(Get* get)
+	: get(get)
+	, path(pathFor(get))
+{
+	if (!load())
+		rebuild();
+}
+
+std::string InstalledDB::pathFor(Get* get)
+{
+	// next to the packages folder, so libget never mistakes it for a package
+	std::string pkgPath = get->mPkg_path.substr(0, get->mPkg_path.size() - 1);
+	return pkgPath.substr(0, pkgPath.rfind('/') + 1) + "installed.db";
+}
+
+void InstalledDB::invalidate(Get* get)
+{
+	std::remove(pathFor(get).c_str());
+}
+
+static void writeString(std::string& out, const std::string& value)
+{
+	uint16_t len = value.size();
+	out.append((const char*)&len, 2);
+	out.append(value);
+}
+
+static bool readString(const std::string& in, size_t& pos, std::string* value)
+{
+	uint16_t len;
+	if (pos + 2 > in.size())
+		return false;
+	memcpy(&len, &in[pos], 2);
+	if (pos + 2 + len > in.size())
+		return false;
+	*value = in.substr(pos + 2, len);
+	pos += 2 + len;
+	return true;
+}
+
+std::string InstalledDB::encode(const InstalledPackage& package)
+{
+	std::string body(1, RECORD_PUT);
+	writeString(body, package.name);
+	writeString(body, package.version);
+
+	uint32_t count = package.files.size();
+	body.append((const char*)&count, 4);
+	for (auto& file : package.files)
+	{
+		body.push_back(file.op);
+		body.push_back(file.hasCrc ? 1 : 0);
+		body.append((const char*)&file.crc, 4);
+		writeString(body, file.path);
+	}
+
+	return body;
+}
+
+std::string InstalledDB::encodeErase(const std::string& name)
+{
+	std::string body(1, RECORD_ERASE);
+	writeString(body, name);
+	return body;
+}
+
+bool InstalledDB::load()
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	// it's small, so the whole log is read at once and indexed from memory
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string data = buffer.str();
+
+	size_t pos = 0;
+	while (pos + 8 <= data.size())
+	{
+		// [body length] [body crc] body
+		uint32_t len, crc;
+		memcpy(&len, &data[pos], 4);
+		memcpy(&crc, &data[pos + 4], 4);
+		if (pos + 8 + len > data.size() || StreamHash::updateCrc(0, &data[pos + 8], len) != crc)
+			break;
+
+		std::string body = data.substr(pos + 8, len);
+		pos += 8 + len;
+		records++;
+
+		size_t at = 1;
+		std::string name;
+		if (body.empty() || !readString(body, at, &name))
+			continue;
+
+		if (body[0] == RECORD_ERASE)
+		{
+			packages.erase(name);
+			continue;
+		}
+
+		InstalledPackage package;
+		package.name = name;
+		uint32_t count;
+		if (!readString(body, at, &package.version) || at + 4 > body.size())
+			continue;
+		memcpy(&count, &body[at], 4);
+		at += 4;
+
+		bool ok = true;
+		for (uint32_t x = 0; ok && x < count; x++)
+		{
+			InstalledFile entry;
+			ok = at + 6 <= body.size();
+			if (!ok)
+				break;
+			entry.op = body[at];
+			entry.hasCrc = body[at + 1] != 0;
+			memcpy(&entry.crc, &body[at + 2], 4);
+			at += 6;
+			ok = readString(body, at, &entry.path);
+			package.files.push_back(entry);
+		}
+
+		if (ok)
+			packages[name] = package;
+	}
+
+	for (auto& package : packages)
+		indexFiles(package.second);
+
+	// a record cut off by a power loss (or too many dead ones) means a rewrite
+	if (pos != data.size() || records > DB_COMPACT_RATIO * (packages.size() + 1))
+		compact();
+
+	printf("--> Loaded %zu installed packages from %s\n", packages.size(), path.c_str());
+	return true;
+}
+
+void InstalledDB::rebuild()
+{
+	// the only time every package folder gets read
+	std::error_code error;
+	for (auto& folder : std::filesystem::directory_iterator(get->mPkg_path, error))
+	{
+		InstalledPackage package;
+		if (folder.is_directory(error) && readFolder(get, folder.path().filename().string(), &package))
+		{
+			indexFiles(package);
+			packages[package.name] = package;
+		}
+	}
+
+	printf("--> Indexed %zu installed packages into %s\n", packages.size(), path.c_str());
+	compact();
+}
+
+void InstalledDB::compact()
+{
+	// written aside and renamed over, so there's always one complete log
+	std::string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (!file)
+		return;
+
+	records = 0;
+	bool ok = true;
+	for (auto& package : packages)
+	{
+		std::string body = encode(package.second);
+		uint32_t len = body.size();
+		uint32_t crc = StreamHash::updateCrc(0, body.data(), body.size());
+		ok = ok && fwrite(&len, 4, 1, file) == 1 && fwrite(&crc, 4, 1, file) == 1 && fwrite(body.data(), 1, len, file) == len;
+		records++;
+	}
+
+	if (fclose(file) == 0 && ok)
+		std::rename(tmpPath.c_str(), path.c_str());
+	else
+		std::remove(tmpPath.c_str());
+}
+
+void InstalledDB::append(const std::string& body)
+{
+	FILE* file = fopen(path.c_str(), "ab");
+	if (!file)
+		return;
+
+	uint32_t len = body.size();
+	uint32_t crc = StreamHash::updateCrc(0, body.data(), body.size());
+	fwrite(&len, 4, 1, file);
+	fwrite(&crc, 4, 1, file);
+	fwrite(body.data(), 1, len, file);
+	fclose(file);
+
+	if (++records > DB_COMPACT_RATIO * (packages.size() + 1))
+		compact();
+}
+
+bool InstalledDB::find(const std::string& name, InstalledPackage* package)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto found = packages.find(name);
+	if (found == packages.end())
+		return false;
+
+	*package = found->second;
+	return true;
+}
+
+std::string InstalledDB::version(const std::string& name)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto found = packages.find(name);
+	return found != packages.end() ? found->second.version : "";
+}
+
+void InstalledDB::put(const InstalledPackage& package)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	unindexFiles(package.name);
+	indexFiles(package);
+	packages[package.name] = package;
+	append(encode(package));
+}
+
+void InstalledDB::erase(const std::string& name)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	unindexFiles(name);
+	if (packages.erase(name))
+		append(encodeErase(name));
+}
+
+void InstalledDB::indexFiles(const InstalledPackage& package)
+{
+	for (auto& file : package.files)
+	{
+		auto& names = fileOwners[file.path];
+		if (std::find(names.begin(), names.end(), package.name) == names.end())
+			names.push_back(package.name);
+	}
+}
+
+void InstalledDB::unindexFiles(const std::string& name)
+{
+	auto found = packages.find(name);
+	if (found == packages.end())
+		return;
+
+	for (auto& file : found->second.files)
+	{
+		auto owned = fileOwners.find(file.path);
+		if (owned == fileOwners.end())
+			continue;
+
+		auto& names = owned->second;
+		names.erase(std::remove(names.begin(), names.end(), name), names.end());
+		if (names.empty())
+			fileOwners.erase(owned);
+	}
+}
+
+std::vector<std::string> InstalledDB::owners(const std::string& path)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto owned = fileOwners.find(path);
+	return owned != fileOwners.end() ? owned->second : std::vector<std::string>();
+}
+
+std::vector<std::pair<std::string, std::string>> InstalledDB::conflicts(const std::string& name, const std::vector<std::string>& paths)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	std::vector<std::pair<std::string, std::string>> found;
+	for (auto& path : paths)
+	{
+		auto owned = fileOwners.find(path);
+		if (owned == fileOwners.end())
+			continue;
+
+		for (auto& owner : owned->second)
+			if (owner != name)
+				found.push_back({ path, owner });
+	}
+
+	return found;
+}
+
+std::vector<std::string> InstalledDB::shared(const std::string& name)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	std::vector<std::string> paths;
+	auto found = packages.find(name);
+	if (found == packages.end())
+		return paths;
+
+	for (auto& file : found->second.files)
+	{
+		auto owned = fileOwners.find(file.path);
+		if (owned != fileOwners.end() && owned->second.size() > 1)
+			paths.push_back(file.path);
+	}
+
+	return paths;
+}
+
+void InstalledDB::refresh(const std::string& name)
+{
+	InstalledPackage package;
+	if (readFolder(get, name, &package))
+		put(package);
+	else
+		erase(name);
+}
+
+bool InstalledDB::readFolder(Get* get, const std::string& name, InstalledPackage* package)
+{
+	std::string folder = get->mPkg_path + name + "/";
+
+	std::ifstream info(folder + "info.json");
+	if (!info.is_open())
+		return false;
+
+	std::stringstream json;
+	json << info.rdbuf();
+	rapidjson::Document doc;
+	doc.Parse(json.str().c_str());
+
+	package->name = name;
+	package->version = (!doc.HasParseError() && doc.IsObject() && doc.HasMember("version") && doc["version"].IsString()) ? doc["version"].GetString() : "";
+	package->files.clear();
+
+	std::unordered_map<std::string, size_t> indexes;
+
+	// "U: switch/appstore/appstore.nro"
+	std::ifstream manifest(folder + "manifest.install");
+	std::string line;
+	while (std::getline(manifest, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.size() < 4 || line[1] != ':')
+			continue;
+
+		InstalledFile file;
+		file.op = line[0];
+		file.path = line.substr(3);
+		indexes[file.path] = package->files.size();
+		package->files.push_back(file);
+	}
+
+	// "0a1b2c3d switch/appstore/appstore.nro", written by our own installs
+	std::ifstream checksums(folder + "files.crc");
+	while (std::getline(checksums, line))
+	{
+		if (line.size() <= 9 || line[8] != ' ')
+			continue;
+
+		std::string path = line.substr(9);
+		auto index = indexes.find(path);
+		if (index == indexes.end())
+		{
+			indexes[path] = package->files.size();
+			package->files.push_back(InstalledFile());
+			package->files.back().path = path;
+			index = indexes.find(path);
+		}
+
+		auto& file = package->files[index->second];
+		file.crc = strtoul(line.substr(0, 8).c_str(), nullptr, 16);
+		file.hasCrc = true;
+	}
+
+	return true;
+}
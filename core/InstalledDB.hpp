@@ -0,0 +1,101 @@
+#ifndef INSTALLEDDB_H_
+#define INSTALLEDDB_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../libs/get/src/Get.hpp"
+
+// once the log holds this many times more records than packages, it's rewritten
+#define DB_COMPACT_RATIO 4
+
+struct InstalledFile
+{
+	std::string path;	// relative to ROOT_PATH, as in manifest.install
+	char op = 'U';		// manifest operation (U, E, G, L)
+	uint32_t crc = 0;
+	bool hasCrc = false;
+};
+
+struct InstalledPackage
+{
+	std::string name;
+	std::string version;
+	std::vector<InstalledFile> files;
+};
+
+// Everything we know about installed packages, in one file next to the packages folder
+// instead of an info.json + manifest.install + files.crc per package. It's an append-only
+// log of length and crc prefixed records (a torn write at the end is just dropped), read
+// in one go at startup into a hash index by package name, and compacted when it gets long.
+// The package folders stay the source of truth: the log is rebuilt from them if it's
+// missing, and refresh() re-reads one package after its files changed behind our back.
+//
+// Alongside it there's a reverse index from installed path to the packages that put a file
+// there, so ownership and conflict questions are one hash lookup per file.
+class InstalledDB
+{
+public:
+	static InstalledDB* db;
+
+	static void init(Get* get);
+	static void quit();
+
+	// copies out the record for this package, false if it isn't installed
+	bool find(const std::string& name, InstalledPackage* package);
+
+	// "" if not installed
+	std::string version(const std::string& name);
+
+	void put(const InstalledPackage& package);
+	void erase(const std::string& name);
+
+	// re-reads a package's folder (eg. after a rollback or a recovered install)
+	void refresh(const std::string& name);
+
+	// the packages that installed this path (relative to ROOT_PATH), empty if none did
+	std::vector<std::string> owners(const std::string& path);
+
+	// (path, owner) for each of these paths that a package other than name already installed
+	std::vector<std::pair<std::string, std::string>> conflicts(const std::string& name, const std::vector<std::string>& paths);
+
+	// files of this package that other packages installed too, and so have to survive its removal
+	std::vector<std::string> shared(const std::string& name);
+
+	// the installed version, manifest and file crcs of a package folder, false if there's no info.json
+	static bool readFolder(Get* get, const std::string& name, InstalledPackage* package);
+
+	// for installs and removals done without the database (eg. console mode), it gets rebuilt next time
+	static void invalidate(Get* get);
+
+private:
+	InstalledDB(Get* get);
+
+	static std::string pathFor(Get* get);
+
+	bool load();
+	void rebuild();
+	void compact();
+	void append(const std::string& record);
+
+	void indexFiles(const InstalledPackage& package);
+	void unindexFiles(const std::string& name);
+
+	static std::string encode(const InstalledPackage& package);
+	static std::string encodeErase(const std::string& name);
+
+	Get* get;
+	std::string path;
+
+	std::mutex lock;
+	std::unordered_map<std::string, InstalledPackage> packages;
+
+	// installed path -> package names, usually just one
+	std::unordered_map<std::string, std::vector<std::string>> fileOwners;
+	size_t records = 0;
+};
+
+#endif
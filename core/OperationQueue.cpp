@@ -0,0 +1,403 @@
+#include "OperationQueue.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "../libs/get/src/Utils.hpp"
+
+#include "BatchInstaller.hpp"
+#include "IndexDigests.hpp"
+#include "InstallJournal.hpp"
+#include "InstalledDB.hpp"
+#include "PackageRemover.hpp"
+#include "PackageInstaller.hpp"
+
+OperationQueue* OperationQueue::queue = nullptr;
+std::mutex OperationQueue::getLock;
+
+void OperationQueue::init(Get* get)
+{
+	if (!queue)
+		queue = new OperationQueue(get);
+}
+
+void OperationQueue::quit()
+{
+	delete queue;
+	queue = nullptr;
+}
+
+OperationQueue::OperationQueue(Get* get)
+	: get(get)
+{
+	// libget reports through these globals, from whichever thread is working
+	networking_callback = OperationQueue::onProgress;
+	libget_status_callback = OperationQueue::onStatus;
+
+	worker = std::thread(&OperationQueue::run, this);
+}
+
+OperationQueue::~OperationQueue()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+		pending.clear();
+	}
+
+	// don't wait for a whole download to finish before exiting
+	cancelRequested = true;
+	wake.notify_all();
+	worker.join();
+
+	networking_callback = nullptr;
+	libget_status_callback = nullptr;
+}
+
+int OperationQueue::enqueue(int kind, const Package& package, const std::string& iconPath, bool quitAfter)
+{
+	Operation op(kind, package);
+	op.iconPath = iconPath;
+	op.quitAfter = quitAfter;
+
+	{
+		// looked up under the same lock, so the package can't be queued twice
+		std::lock_guard<std::mutex> guard(lock);
+		int existing = findLocked(package.getPackageName());
+		if (existing >= 0)
+			return existing;
+
+		op.id = nextId++;
+		pending.push_back(op);
+		progress.pending = pending.size();
+	}
+
+	wake.notify_one();
+	return op.id;
+}
+
+void OperationQueue::enqueueBatch(const std::vector<Package>& packages)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		int batch = nextBatch++;
+
+		for (auto& package : packages)
+		{
+			// already queued on its own
+			if (findLocked(package.getPackageName()) >= 0)
+				continue;
+
+			Operation op(OP_INSTALL, package);
+			op.id = nextId++;
+			op.batch = batch;
+			pending.push_back(op);
+		}
+
+		progress.pending = pending.size();
+	}
+
+	wake.notify_one();
+}
+
+bool OperationQueue::cancel(const std::string& packageName)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	for (auto it = pending.begin(); it != pending.end(); it++)
+	{
+		if (it->package.getPackageName() != packageName)
+			continue;
+
+		it->cancelled = true;
+		finished.push_back(*it);
+		pending.erase(it);
+		progress.pending = pending.size();
+		return true;
+	}
+
+	for (auto& op : running)
+	{
+		if (op.package.getPackageName() != packageName)
+			continue;
+
+		// the next progress callback aborts the transfer, in a batch only this package's
+		if (running.size() > 1)
+			droppedIds.push_back(op.id);
+		else
+			cancelRequested = true;
+		return true;
+	}
+
+	return false;
+}
+
+int OperationQueue::find(const std::string& packageName)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return findLocked(packageName);
+}
+
+int OperationQueue::findLocked(const std::string& packageName)
+{
+	for (auto& op : running)
+		if (op.package.getPackageName() == packageName)
+			return op.id;
+
+	for (auto& op : pending)
+		if (op.package.getPackageName() == packageName)
+			return op.id;
+
+	return -1;
+}
+
+std::string OperationQueue::title(int id)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	for (auto& op : running)
+		if (op.id == id)
+			return op.package.getTitle();
+
+	for (auto& op : pending)
+		if (op.id == id)
+			return op.package.getTitle();
+
+	return "";
+}
+
+std::vector<Operation> OperationQueue::takeFinished()
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	std::vector<Operation> done;
+	done.swap(finished);
+	return done;
+}
+
+bool OperationQueue::takeVerified(const std::string& packageName, Operation* result)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	for (auto it = verified.begin(); it != verified.end(); it++)
+	{
+		if (it->package.getPackageName() != packageName)
+			continue;
+
+		*result = *it;
+		verified.erase(it);
+		return true;
+	}
+
+	return false;
+}
+
+void OperationQueue::run()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return stopping || !pending.empty(); });
+
+			if (stopping)
+				return;
+
+			running.push_back(pending.front());
+			pending.pop_front();
+
+			// the rest of its batch runs along with it
+			int batch = running.front().batch;
+			for (auto it = pending.begin(); batch >= 0 && it != pending.end();)
+			{
+				if (it->batch != batch)
+				{
+					it++;
+					continue;
+				}
+
+				running.push_back(*it);
+				it = pending.erase(it);
+			}
+
+			progress.pending = pending.size();
+			droppedIds.clear();
+		}
+
+		cancelRequested = false;
+		progress.bytesNow = 0;
+		progress.bytesTotal = 0;
+		progress.item = 1;
+		progress.itemTotal = running.size();
+		int kind = running.front().kind;
+		progress.stage = kind == OP_REMOVE ? STATUS_REMOVING : kind == OP_VERIFY ? STATUS_ANALYZING : kind == OP_ROLLBACK ? STATUS_INSTALLING : STATUS_DOWNLOADING;
+		progress.lastId = running.back().id;
+		progress.currentId = running.front().id;
+
+		if (running.size() > 1)
+			executeBatch(running);
+		else
+			running.front().succeeded = execute(running.front());
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			for (auto& op : running)
+			{
+				op.cancelled = (cancelRequested || dropped(op.id)) && !op.succeeded;
+				finished.push_back(op);
+
+				// kept for the details screen that asked for it
+				if (op.kind == OP_VERIFY)
+					verified.push_back(op);
+			}
+			running.clear();
+		}
+
+		progress.currentId = -1;
+		progress.lastId = -1;
+		progress.stage = -1;
+
+		if (onFinished)
+			onFinished();
+	}
+}
+
+bool OperationQueue::execute(Operation& op)
+{
+	if (op.kind == OP_REMOVE)
+	{
+		// a removal cut short by a power loss gets finished on the next launch, and
+		// files other installed packages also own are set aside so they survive it
+		std::vector<std::string> shared;
+		if (InstalledDB::db)
+			shared = InstalledDB::db->shared(op.package.getPackageName());
+		InstallJournal::beginRemoval(get, op.package.getPackageName(), shared);
+
+		// the files are deleted without get's state, only the status reload needs the lock
+		bool removed = PackageRemover::remove(get, op.package.getPackageName());
+
+		// get->remove is only for packages without a record, one that's kept still lists the files that are left
+		bool untracked = !removed && !PackageRemover::tracked(get, op.package.getPackageName());
+
+		// the record goes first, the status reload reads it
+		if (removed && InstalledDB::db)
+			InstalledDB::db->erase(op.package.getPackageName());
+
+		{
+			std::lock_guard<std::mutex> guard(getLock);
+			if (removed)
+				reload();
+			else if (untracked && (removed = get->remove(op.package)) && InstalledDB::db)
+				InstalledDB::db->erase(op.package.getPackageName());
+		}
+
+		InstallJournal::endRemoval(get, op.package.getPackageName());
+		return removed;
+	}
+
+	// just renames, nothing to download
+	if (op.kind == OP_ROLLBACK)
+	{
+		bool rolledBack = InstallJournal::rollback(get, op.package.getPackageName());
+
+		// the package folder was swapped too, so its record is read back from it
+		if (rolledBack && InstalledDB::db)
+			InstalledDB::db->refresh(op.package.getPackageName());
+
+		std::lock_guard<std::mutex> guard(getLock);
+		reload();
+		return rolledBack;
+	}
+
+	// only reads files back, package statuses don't change
+	if (op.kind == OP_VERIFY)
+	{
+		op.checked = PackageInstaller::verify(get, op.package, &op.damaged);
+		return op.checked >= 0 && op.damaged.empty();
+	}
+
+	// the download and extraction don't touch get's state, so the ui can keep using it
+	bool succeeded = PackageInstaller::install(get, op.package);
+
+	if (succeeded && !op.iconPath.empty())
+	{
+		// keep the icon on the SD card, for offline use
+		auto iconSavePath = get->mPkg_path + op.package.getPackageName() + "/icon.png";
+		std::remove(iconSavePath.c_str());
+		std::rename(op.iconPath.c_str(), iconSavePath.c_str());
+	}
+	else if (!op.iconPath.empty())
+		std::remove(op.iconPath.c_str());
+
+	// reload package statuses, same as get->install does after installing
+	std::lock_guard<std::mutex> guard(getLock);
+	reload();
+
+	return succeeded;
+}
+
+void OperationQueue::executeBatch(std::vector<Operation>& ops)
+{
+	std::vector<Package*> packages;
+	for (auto& op : ops)
+		packages.push_back(&op.package);
+
+	BatchInstaller batch(get, packages);
+	batch.onProgress = [this, &batch]() {
+		progress.bytesNow = batch.bytesNow;
+		progress.bytesTotal = batch.bytesTotal;
+		return cancelRequested ? 1 : 0;
+	};
+	batch.dropped = [this, &ops](int index) {
+		std::lock_guard<std::mutex> guard(lock);
+		return dropped(ops[index].id);
+	};
+
+	auto results = batch.run();
+	for (size_t x = 0; x < ops.size(); x++)
+		ops[x].succeeded = results[x];
+
+	// one status reload for the whole batch
+	std::lock_guard<std::mutex> guard(getLock);
+	reload();
+}
+
+bool OperationQueue::dropped(int id)
+{
+	return std::find(droppedIds.begin(), droppedIds.end(), id) != droppedIds.end();
+}
+
+void OperationQueue::reload()
+{
+	// get->update() fetches the repo indexes again, a republished zip comes with new digests
+	get->update();
+	IndexDigests::invalidate();
+}
+
+int OperationQueue::onProgress(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow)
+{
+	// requests made by the ui thread go through the same callback, they aren't ours to report
+	if (!queue || std::this_thread::get_id() != queue->worker.get_id())
+		return 0;
+
+	// a batch reports its own summed progress, not each request's
+	if (queue->progress.lastId == queue->progress.currentId)
+	{
+		queue->progress.bytesNow = dlnow;
+		queue->progress.bytesTotal = dltotal;
+	}
+
+	// a non-zero return aborts the transfer
+	return queue->cancelRequested ? 1 : 0;
+}
+
+int OperationQueue::onStatus(int status, int num, int num_total)
+{
+	if (!queue || std::this_thread::get_id() != queue->worker.get_id())
+		return 0;
+
+	queue->progress.item = num;
+	queue->progress.itemTotal = num_total;
+	queue->progress.stage = status;
+	return 0;
+}
@@ -0,0 +1,147 @@
+#ifndef OPERATIONQUEUE_H_
+#define OPERATIONQUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../libs/get/src/Get.hpp"
+
+#define OP_INSTALL 0
+#define OP_REMOVE 1
+#define OP_VERIFY 2
+#define OP_ROLLBACK 3
+
+struct Operation
+{
+	Operation(int kind, const Package& package)
+		: kind(kind)
+		, package(package)
+	{
+	}
+
+	int id = -1;
+	int kind;
+
+	// a copy, so the operation doesn't depend on whichever screen queued it
+	Package package;
+
+	// icon saved by the ui when queued, moved into the package folder once installed
+	std::string iconPath;
+
+	// on some platform + package combinations, the app has to quit once this finishes
+	bool quitAfter = false;
+
+	// operations queued together (eg. update all) run as one batch, -1 if not part of one
+	int batch = -1;
+
+	bool succeeded = false;
+	bool cancelled = false;
+
+	// for a verify, how many installed files were checked (-1 if none were recorded) and which failed
+	int checked = 0;
+	std::vector<std::string> damaged;
+};
+
+// Progress of the running operation. Only the worker thread writes it, and the
+// main loop reads it every frame without taking any locks.
+struct OperationProgress
+{
+	std::atomic<int> currentId { -1 };	// id of the running operation, -1 when idle
+	std::atomic<int> lastId { -1 };		// a running batch covers the ids currentId to lastId
+	std::atomic<int> stage { -1 };		// STATUS_* value from libget
+	std::atomic<int> item { 1 };		// num/num_total from the libget status callback
+	std::atomic<int> itemTotal { 1 };
+	std::atomic<int64_t> bytesNow { 0 };
+	std::atomic<int64_t> bytesTotal { 0 };
+	std::atomic<int> pending { 0 };		// operations waiting behind the running one
+};
+
+// Runs package installs, removals, verifies and rollbacks one at a time on a background thread, so
+// the ui keeps going (and can queue or cancel more) while they work.
+class OperationQueue
+{
+public:
+	static OperationQueue* queue;
+
+	static void init(Get* get);
+	static void quit();
+
+	// held whenever get's package list or statuses are touched, by either thread
+	static std::mutex getLock;
+
+	// returns the id of the queued operation (or the existing one for this package)
+	int enqueue(int kind, const Package& package, const std::string& iconPath = "", bool quitAfter = false);
+
+	// queues installs for all of these packages, downloaded concurrently as one batch
+	void enqueueBatch(const std::vector<Package>& packages);
+
+	// drops a waiting operation, or aborts the running one's download (just this package's, if in a batch)
+	bool cancel(const std::string& packageName);
+
+	// id of the waiting or running operation for this package, -1 if none
+	int find(const std::string& packageName);
+
+	// whether the operation with this id is the one running (or in the running batch)
+	bool isRunning(int id) const { return id >= progress.currentId && id <= progress.lastId; }
+
+	// title of the package a waiting or running operation is for
+	std::string title(int id);
+
+	// operations that finished since the last call
+	std::vector<Operation> takeFinished();
+
+	// the result of this package's last verify, if it finished since the last call
+	bool takeVerified(const std::string& packageName, Operation* result);
+
+	OperationProgress progress;
+
+	// called on the worker thread after operations finish, so an idle ui can pick them up
+	std::function<void()> onFinished;
+
+private:
+	OperationQueue(Get* get);
+	~OperationQueue();
+
+	void run();
+	bool execute(Operation& op);
+	void executeBatch(std::vector<Operation>& ops);
+
+	// reloads package statuses, call with getLock held
+	void reload();
+
+	// find(), call with lock held
+	int findLocked(const std::string& packageName);
+
+	// whether this member of the running batch was cancelled on its own, call with lock held
+	bool dropped(int id);
+
+	static int onProgress(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow);
+	static int onStatus(int status, int num, int num_total);
+
+	Get* get;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<Operation> pending;
+	std::vector<Operation> running;
+	std::vector<Operation> finished;
+	std::vector<Operation> verified;
+	int nextId = 0;
+	int nextBatch = 0;
+
+	std::atomic<bool> cancelRequested { false };
+
+	// ids of running batch members that were cancelled, the rest of the batch goes on
+	std::vector<int> droppedIds;
+	bool stopping = false;
+
+	std::thread worker;
+};
+
+#endif
@@ -0,0 +1,795 @@
+#include "PackageInstaller.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <vector>
+
+#include "../libs/get/src/Utils.hpp"
+
+int PackageInstaller::downloadSegments = 1;
+
+bool PackageInstaller::install(Get* get, Package& package)
+{
+	// a prefetch that didn't finish hands over the start of the zip, and only the rest is downloaded
+	// (stopping it first, so this also catches one finishing right now)
+	std::string partial;
+	if (PackagePrefetch::prefetch && PackagePrefetch::prefetch->takePartial(package, &partial))
+	{
+		PackageInstaller installer(get, package);
+		installer.partialZip = partial;
+		bool installed = installer.run();
+		std::remove(partial.c_str());
+		if (installed || !installer.resumeFailed)
+			return installed;
+
+		printf("--> Couldn't resume the prefetch of %s, downloading it again\n", package.getPackageName().c_str());
+	}
+
+	// a zip prefetched while the details page was open only needs extracting
+	std::string prefetched;
+	if (PackagePrefetch::prefetch && PackagePrefetch::prefetch->take(package, &prefetched))
+	{
+		if (libget_status_callback)
+			libget_status_callback(STATUS_INSTALLING, 1, 1);
+
+		bool installed = installFromFile(get, package, prefetched);
+		std::remove(prefetched.c_str());
+		if (installed)
+			return true;
+
+		printf("--> Prefetched zip for %s didn't install, downloading it again\n", package.getPackageName().c_str());
+	}
+
+	PackageInstaller installer(get, package);
+	return installer.run();
+}
+
+bool PackageInstaller::installFromFile(Get* get, Package& package, const std::string& zipPath)
+{
+	PackageInstaller installer(get, package);
+	installer.zipPath = zipPath;
+	installer.localZip = true;
+	return installer.run();
+}
+
+PackageInstaller::PackageInstaller(Get* get, Package& package)
+	: get(get)
+	, package(package)
+	, pkgDir(get->mPkg_path + package.getPackageName() + "/")
+	, zip(this, get->mTmp_path + package.getPackageName() + ".spill")
+	, zipPath(get->mTmp_path + package.getPackageName() + ".zip")
+	, journal(get, package.getPackageName())
+{
+}
+
+bool PackageInstaller::run()
+{
+	if (libget_status_callback && !localZip)
+		libget_status_callback(STATUS_DOWNLOADING, 1, 1);
+
+	loadManifest();
+
+	// an update only needs the files that changed, if the server lets us pick them out of the zip
+	delta = !localZip && planDelta();
+	if (!delta)
+		fileCrcs.clear();
+
+	// a delta only sees parts of the archive, so there's nothing to check the whole digest against
+	expected = IndexDigests::lookup(get, package.getPackageName());
+	hashing = !delta && expected.known();
+	archiveHash = StreamHash(hashing && !expected.sha256.empty());
+
+	// a segmented download left behind by an earlier attempt is picked up again
+	bool segmented = downloadSegments > 1 || RangeDownload::hasPartial(zipPath);
+
+	bool fetched;
+	if (localZip)
+		fetched = extractFile(zipPath) && zip.finish();
+	else if (delta)
+		fetched = downloadDelta();
+	else
+		fetched = (segmented ? downloadSegmented() : download()) && zip.finish();
+
+	if (fetched && hashing && !checkDigest())
+		fetched = false;
+
+	// the writer may still have files queued up
+	if (fetched && !pipeline.flush())
+	{
+		printf("--> Couldn't extract %s: %s\n", package.getPackageName().c_str(), pipeline.error.c_str());
+		fetched = false;
+	}
+
+	if (!fetched)
+	{
+		printf("--> Could not install package %s\n", package.getPackageName().c_str());
+		return false;
+	}
+
+	if (libget_status_callback && !localZip)
+		libget_status_callback(STATUS_INSTALLING, 1, 1);
+
+	if (!writeMetadata())
+		return false;
+
+	removeStaleFiles();
+	writeChecksums();
+
+	// the only step that touches the installed files
+	if (!journal.commit())
+		return false;
+
+	recordInstall();
+
+	printf("--> Installed %s to sdroot/\n", package.getPackageName().c_str());
+	return true;
+}
+
+// parses manifest.install lines, which look like "U: switch/appstore/appstore.nro"
+static void parseManifest(std::istream& lines, std::unordered_map<std::string, char>& operations)
+{
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		if (line.size() < 4 || line[1] != ':')
+			continue;
+
+		operations[line.substr(3)] = line[0];
+	}
+}
+
+void PackageInstaller::loadManifest()
+{
+	// what the installed version put on the SD card, read before the update overwrites it
+	InstalledPackage installed;
+	if (InstalledDB::db ? InstalledDB::db->find(package.getPackageName(), &installed) : InstalledDB::readFolder(get, package.getPackageName(), &installed))
+	{
+		for (auto& file : installed.files)
+		{
+			previousOperations[file.path] = file.op;
+
+			// a delta update keeps the recorded crcs of the files it doesn't touch
+			if (file.hasCrc)
+				fileCrcs[file.path] = file.crc;
+		}
+	}
+
+	// entries can show up in any order in the zip, so we need the
+	// manifest operations before the first one arrives
+	if (!ConnectionPool::pool->fetch(package.getManifestUrl(), &manifestData, PRIORITY_INSTALL))
+	{
+		// without a manifest, everything in the zip gets extracted
+		printf("--> Couldn't fetch manifest for %s, extracting all files\n", package.getPackageName().c_str());
+		manifestData.clear();
+		return;
+	}
+
+	std::istringstream lines(manifestData);
+	parseManifest(lines, operations);
+}
+
+#ifndef NETWORK_MOCK
+size_t PackageInstaller::onData(char* data, size_t size, size_t nmemb, void* userp)
+{
+	auto installer = (PackageInstaller*)userp;
+
+	// returning short aborts the transfer
+	return installer->feedArchive(data, size * nmemb) ? size * nmemb : 0;
+}
+
+size_t PackageInstaller::onBuffer(char* data, size_t size, size_t nmemb, void* userp)
+{
+	((std::string*)userp)->append(data, size * nmemb);
+	return size * nmemb;
+}
+
+int PackageInstaller::onProgress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+	auto installer = (PackageInstaller*)clientp;
+
+	// after a resume curl only counts the remaining bytes, and a delta spans several requests
+	double total = installer->delta ? installer->deltaBytes : dltotal + installer->resumeOffset;
+	if (networking_callback)
+		return networking_callback(nullptr, total, dlnow + installer->resumeOffset, ultotal, ulnow);
+	return 0;
+}
+#endif
+
+bool PackageInstaller::download()
+{
+	if (!partialZip.empty() && !extractFile(partialZip))
+	{
+		resumeFailed = true;
+		return false;
+	}
+
+	uint64_t start = zip.consumed();
+
+#ifndef NETWORK_MOCK
+	if (streamZip(package.getZipUrl(), zip, PackageInstaller::onData, PackageInstaller::onProgress, this, &resumeOffset))
+		return true;
+#else
+	std::string data;
+	if (ConnectionPool::pool->fetch(package.getZipUrl(), &data, PRIORITY_INSTALL) && data.size() >= start && feedArchive(data.data() + start, data.size() - start))
+		return true;
+#endif
+
+	// nothing arrived past what the prefetch had, so the server won't resume it
+	resumeFailed = !partialZip.empty() && zip.consumed() == start;
+	return false;
+}
+
+#ifndef NETWORK_MOCK
+bool PackageInstaller::streamZip(const std::string& url, ZipStream& zip, curl_write_callback write, curl_xferinfo_callback progress, void* userp, uint64_t* resumeOffset)
+{
+	for (int attempt = 0; attempt <= RANGE_RETRIES; attempt++)
+	{
+		CURL* curl = ConnectionPool::pool->acquire(url, PRIORITY_INSTALL);
+		if (!curl)
+			return false;
+
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, userp);
+		if (progress)
+		{
+			curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+			curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress);
+			curl_easy_setopt(curl, CURLOPT_XFERINFODATA, userp);
+		}
+
+		// a stalled connection counts as dropped
+		curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+		curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 20L);
+
+		// the zip stream is still waiting for the next byte, so ask the server to start there
+		*resumeOffset = zip.consumed();
+		if (*resumeOffset > 0)
+			curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)*resumeOffset);
+
+		CURLcode res = curl_easy_perform(curl);
+		ConnectionPool::pool->release(curl);
+
+		if (res == CURLE_OK)
+			return true;
+
+		printf("--> Couldn't download %s: %s\n", url.c_str(), curl_easy_strerror(res));
+
+		// bad data, a cancel, or a server without range support can't be fixed by retrying
+		if (res == CURLE_WRITE_ERROR || res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_RANGE_ERROR || res == CURLE_HTTP_RETURNED_ERROR)
+			return false;
+
+		printf("--> Resuming at %llu bytes\n", (unsigned long long)zip.consumed());
+	}
+
+	return false;
+}
+#endif
+
+// writes every entry under a folder, with nothing staged or recorded
+class FolderSink : public ZipEntrySink
+{
+public:
+	FolderSink(const std::string& folder)
+		: folder(folder)
+	{
+	}
+
+	bool beginEntry(const std::string& name, uint64_t size)
+	{
+		std::string path = folder + name;
+		mkpath(path.substr(0, path.find_last_of('/') + 1));
+
+		// directories have no data to write
+		if (name.empty() || name.back() == '/')
+			return false;
+
+		file = fopen(path.c_str(), "wb");
+		return file != nullptr;
+	}
+
+	bool writeEntry(const char* data, size_t len)
+	{
+		return fwrite(data, 1, len, file) == len;
+	}
+
+	bool endEntry(bool valid)
+	{
+		fclose(file);
+		file = nullptr;
+		return valid;
+	}
+
+	~FolderSink()
+	{
+		if (file)
+			fclose(file);
+	}
+
+private:
+	std::string folder;
+	FILE* file = nullptr;
+};
+
+#ifndef NETWORK_MOCK
+static size_t feedZip(char* data, size_t size, size_t nmemb, void* userp)
+{
+	return ((ZipStream*)userp)->feed(data, size * nmemb) ? size * nmemb : 0;
+}
+#endif
+
+bool PackageInstaller::extractUrl(const std::string& url, const std::string& folder)
+{
+	std::string path = folder.back() == '/' ? folder : folder + "/";
+	FolderSink sink(path);
+	ZipStream zip(&sink, path.substr(0, path.size() - 1) + ".spill");
+
+#ifndef NETWORK_MOCK
+	uint64_t resumeOffset = 0;
+	bool fetched = streamZip(url, zip, feedZip, nullptr, &zip, &resumeOffset);
+#else
+	std::string data;
+	bool fetched = ConnectionPool::pool->fetch(url, &data, PRIORITY_INSTALL) && zip.feed(data.data(), data.size());
+#endif
+
+	if (!fetched || !zip.finish())
+	{
+		printf("--> Couldn't extract %s: %s\n", url.c_str(), zip.error.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool PackageInstaller::downloadSegmented()
+{
+	RangeDownload download(package.getZipUrl(), zipPath, downloadSegments);
+	if (!download.run())
+	{
+		// the partial zip stays in the temp folder for the next attempt
+		printf("--> Couldn't download %s\n", package.getZipUrl().c_str());
+		return false;
+	}
+
+	bool extracted = extractFile(zipPath);
+	std::remove(zipPath.c_str());
+	return extracted;
+}
+
+bool PackageInstaller::extractFile(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	// same extraction as the streaming path, just reading from disk instead
+	std::vector<char> buffer(ZIP_INFLATE_CHUNK);
+	bool ok = true;
+	size_t len;
+	while (ok && (len = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+		ok = feedArchive(buffer.data(), len);
+
+	fclose(file);
+	return ok;
+}
+
+bool PackageInstaller::feedArchive(const char* data, size_t len)
+{
+	// hashed on the way through, so checking the digest doesn't need another pass
+	if (hashing)
+		archiveHash.update(data, len);
+
+	return zip.feed(data, len);
+}
+
+bool PackageInstaller::checkDigest()
+{
+	if (expected.hasCrc && archiveHash.crc() != expected.crc)
+	{
+		printf("--> %s doesn't match the repo's crc32 (%08x, expected %08x)\n", package.getPackageName().c_str(), archiveHash.crc(), expected.crc);
+		return false;
+	}
+
+	std::string sha256 = archiveHash.sha256();
+	if (!expected.sha256.empty() && sha256 != expected.sha256)
+	{
+		printf("--> %s doesn't match the repo's sha256 (%s, expected %s)\n", package.getPackageName().c_str(), sha256.c_str(), expected.sha256.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool PackageInstaller::fetchRange(const std::string& range, std::string* buffer)
+{
+#ifndef NETWORK_MOCK
+	CURL* curl = ConnectionPool::pool->acquire(package.getZipUrl(), PRIORITY_INSTALL);
+	if (!curl)
+		return false;
+
+	curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PackageInstaller::onBuffer);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, buffer);
+
+	CURLcode res = curl_easy_perform(curl);
+	long code = 0;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+	ConnectionPool::pool->release(curl);
+
+	// anything but a partial response means the server ignored the range
+	return res == CURLE_OK && code == 206;
+#else
+	return false;
+#endif
+}
+
+bool PackageInstaller::sameFile(const std::string& path, uint64_t size, uint32_t crc)
+{
+	struct stat buffer;
+	if (stat(path.c_str(), &buffer) != 0 || (uint64_t)buffer.st_size != size)
+		return false;
+
+	// reading a file back is much cheaper than downloading and rewriting it
+	uint32_t sum;
+	return StreamHash::crcFile(path, &sum) && sum == crc;
+}
+
+bool PackageInstaller::planDelta()
+{
+	// only updates have installed files to compare against, and we need to know which files are ours
+	if (package.getStatus() != UPDATE || operations.empty() || previousOperations.empty())
+		return false;
+
+	// the end of central directory record is within the last 64k + 22 bytes
+	std::string tail;
+	if (!fetchRange("-" + std::to_string(0xFFFF + 22), &tail))
+		return false;
+
+	uint32_t cdOffset, cdSize;
+	size_t eocd;
+	if (!ZipStream::findCentralDirectory(tail, &cdOffset, &cdSize, &eocd))
+		return false;
+
+	// the central directory sits right before the end record, which tells us where the tail starts
+	uint64_t archiveSize = (uint64_t)cdOffset + cdSize + (tail.size() - eocd);
+	uint64_t tailStart = (uint64_t)cdOffset + cdSize - eocd;
+
+	std::string cd;
+	if (cdOffset >= tailStart)
+		cd = tail.substr(cdOffset - tailStart, cdSize);
+	else if (!fetchRange(std::to_string(cdOffset) + "-" + std::to_string(cdOffset + cdSize - 1), &cd))
+		return false;
+
+	std::vector<ZipEntryInfo> entries;
+	if (!ZipStream::parseCentralDirectory(cd, &entries))
+		return false;
+
+	std::sort(entries.begin(), entries.end(), [](const ZipEntryInfo& a, const ZipEntryInfo& b) {
+		return a.localOffset < b.localOffset;
+	});
+
+	for (size_t x = 0; x < entries.size(); x++)
+	{
+		auto& entry = entries[x];
+		if (!entry.name.empty() && entry.name.back() == '/')
+			continue;
+
+		// this entry can't be extracted on its own, so the whole zip it is
+		if (!entry.streamable())
+			return false;
+
+		std::string path = destinationFor(entry.name);
+		if (path.empty() || sameFile(path, entry.size, entry.crc))
+			continue;
+
+		// an entry runs from its local header to the next one (or the central directory)
+		uint64_t end = (x + 1 < entries.size()) ? entries[x + 1].localOffset : cdOffset;
+		deltaEntries.insert(entry.name);
+
+		if (!deltaRanges.empty() && entry.localOffset - deltaRanges.back().second < DELTA_GAP)
+			deltaRanges.back().second = end;
+		else
+			deltaRanges.push_back({ entry.localOffset, end });
+	}
+
+	deltaBytes = 0;
+	for (auto& range : deltaRanges)
+		deltaBytes += range.second - range.first;
+
+	if (deltaBytes * 100 > archiveSize * DELTA_MAX_PERCENT)
+	{
+		deltaRanges.clear();
+		deltaEntries.clear();
+		return false;
+	}
+
+	printf("--> Delta update of %s: %zu changed files, %llu of %llu bytes\n", package.getPackageName().c_str(),
+		deltaEntries.size(), (unsigned long long)deltaBytes, (unsigned long long)archiveSize);
+	return true;
+}
+
+bool PackageInstaller::downloadDelta()
+{
+#ifndef NETWORK_MOCK
+	resumeOffset = 0;
+
+	for (auto& range : deltaRanges)
+	{
+		CURL* curl = ConnectionPool::pool->acquire(package.getZipUrl(), PRIORITY_INSTALL);
+		if (!curl)
+			return false;
+
+		std::string bytes = std::to_string(range.first) + "-" + std::to_string(range.second - 1);
+		curl_easy_setopt(curl, CURLOPT_RANGE, bytes.c_str());
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PackageInstaller::onData);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+		curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+		curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, PackageInstaller::onProgress);
+		curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+
+		CURLcode res = curl_easy_perform(curl);
+		long code = 0;
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+		ConnectionPool::pool->release(curl);
+
+		if (res != CURLE_OK)
+		{
+			printf("--> Couldn't download part of %s: %s\n", package.getZipUrl().c_str(), curl_easy_strerror(res));
+			return false;
+		}
+
+		// the server sent the whole zip after all, everything not in the delta was skipped anyway
+		if (code != 206)
+			return zip.finish();
+
+		resumeOffset += range.second - range.first;
+	}
+
+	return zip.betweenEntries();
+#else
+	return false;
+#endif
+}
+
+void PackageInstaller::removeStaleFiles()
+{
+	// without the new manifest we can't tell what was dropped
+	if (operations.empty())
+		return;
+
+	for (auto& previous : previousOperations)
+	{
+		// only files the package itself kept up to date, never local or config files
+		if (previous.second != 'U' || operations.count(previous.first))
+			continue;
+
+		printf("--> Removing %s, it's no longer part of %s\n", previous.first.c_str(), package.getPackageName().c_str());
+		journal.remove(ROOT_PATH + previous.first);
+		fileCrcs.erase(previous.first);
+	}
+}
+
+bool PackageInstaller::writeMetadata()
+{
+	// the zip normally carries its own manifest, if not keep the one we fetched
+	if (!zipHadManifest && !manifestData.empty())
+	{
+		std::ofstream manifest(journal.stage(pkgDir + "manifest.install"));
+		manifest << manifestData;
+	}
+
+	// the installed version is what package statuses are computed from
+	std::ofstream info(journal.stage(pkgDir + "info.json"));
+	if (!info.is_open())
+	{
+		printf("--> Couldn't write info.json for %s\n", package.getPackageName().c_str());
+		return false;
+	}
+	info << "{\"version\": \"" << package.getVersion() << "\"}\n";
+
+	return true;
+}
+
+void PackageInstaller::writeChecksums()
+{
+	// one "crc path" line per file, what verify compares the SD card against
+	std::ofstream checksums(journal.stage(pkgDir + "files.crc"));
+	char crc[10];
+	for (auto& file : fileCrcs)
+	{
+		snprintf(crc, sizeof(crc), "%08x ", file.second);
+		checksums << crc << file.first << "\n";
+	}
+}
+
+void PackageInstaller::recordInstall()
+{
+	if (!InstalledDB::db)
+		return;
+
+	InstalledPackage installed;
+	installed.name = package.getPackageName();
+	installed.version = package.getVersion();
+
+	// every file the manifest lists, plus any we extracted without one
+	for (auto& op : operations)
+	{
+		InstalledFile file;
+		file.path = op.first;
+		file.op = op.second;
+
+		auto crc = fileCrcs.find(op.first);
+		file.hasCrc = crc != fileCrcs.end();
+		file.crc = file.hasCrc ? crc->second : 0;
+		installed.files.push_back(file);
+	}
+
+	for (auto& crc : fileCrcs)
+	{
+		if (operations.count(crc.first))
+			continue;
+
+		InstalledFile file;
+		file.path = crc.first;
+		file.crc = crc.second;
+		file.hasCrc = true;
+		installed.files.push_back(file);
+	}
+
+	InstalledDB::db->put(installed);
+}
+
+int PackageInstaller::verify(Get* get, const Package& package, std::vector<std::string>* damaged)
+{
+	InstalledPackage installed;
+	if (!(InstalledDB::db ? InstalledDB::db->find(package.getPackageName(), &installed) : InstalledDB::readFolder(get, package.getPackageName(), &installed)))
+		return -1;
+
+	std::vector<std::pair<std::string, uint32_t>> files;
+	for (auto& file : installed.files)
+		if (file.hasCrc)
+			files.push_back({ file.path, file.crc });
+
+	// installed before crcs were recorded
+	if (files.empty())
+		return -1;
+
+	for (size_t x = 0; x < files.size(); x++)
+	{
+		if (libget_status_callback)
+			libget_status_callback(STATUS_ANALYZING, x + 1, files.size());
+
+		uint32_t crc;
+		if (!StreamHash::crcFile(ROOT_PATH + files[x].first, &crc) || crc != files[x].second)
+			damaged->push_back(files[x].first);
+	}
+
+	return files.size();
+}
+
+std::string PackageInstaller::destinationFor(const std::string& name)
+{
+	// loose files at the root of the zip are package metadata (manifest.install, info.json, icons)
+	if (name.find('/') == std::string::npos)
+	{
+		zipHadManifest |= name == "manifest.install";
+
+		// we write our own info.json once the install succeeds
+		return name == "info.json" ? "" : pkgDir + name;
+	}
+
+	if (!operations.empty())
+	{
+		auto op = operations.find(name);
+
+		// only files the manifest knows about are installed
+		if (op == operations.end())
+			return "";
+
+		struct stat buffer;
+		switch (op->second)
+		{
+			case 'L':
+				// local files are never touched by an install
+				return "";
+			case 'E':
+				// extract only if it doesn't already exist (eg. config files)
+				if (stat((ROOT_PATH + name).c_str(), &buffer) == 0)
+					return "";
+				break;
+			default:
+				break;
+		}
+	}
+
+	return ROOT_PATH + name;
+}
+
+bool PackageInstaller::wantsEntry(const std::string& name)
+{
+	// directories get created as the files inside of them are extracted
+	if (!name.empty() && name.back() == '/')
+		return false;
+
+	// unchanged files that happen to sit between changed ones in a delta range
+	return !delta || deltaEntries.count(name);
+}
+
+bool PackageInstaller::tracked(const std::string& name)
+{
+	// package metadata and files the user is expected to change aren't verified
+	if (name.find('/') == std::string::npos)
+		return false;
+
+	auto op = operations.find(name);
+	return op == operations.end() || op->second != 'E';
+}
+
+bool PackageInstaller::beginEntry(const std::string& name, uint64_t size)
+{
+	if (!wantsEntry(name))
+		return false;
+
+	std::string path = destinationFor(name);
+	if (path.empty())
+		return false;
+
+	// false skips the entry, but one that can't be created also fails the pipeline, so run() stops before the commit
+	currentEntry = name;
+	return pipeline.open(journal.stage(path));
+}
+
+bool PackageInstaller::writeEntry(const char* data, size_t len)
+{
+	return pipeline.write(data, len);
+}
+
+bool PackageInstaller::endEntry(bool valid)
+{
+	if (valid && tracked(currentEntry))
+		fileCrcs[currentEntry] = zip.entryCrc();
+
+	return pipeline.close(valid);
+}
+
+bool PackageInstaller::beginCompressed(const std::string& name, uint16_t method, uint32_t crc, uint64_t compSize, uint64_t size)
+{
+	// big entries are inflated as they stream in instead of held in memory
+	if (!pipeline.parallel() || size > PARALLEL_ENTRY_MAX || compSize > PARALLEL_ENTRY_MAX)
+		return false;
+
+	if (!wantsEntry(name))
+		return false;
+
+	std::string path = destinationFor(name);
+	if (path.empty())
+		return false;
+
+	pendingName = name;
+	pendingPath = journal.stage(path);
+	pendingMethod = method;
+	pendingCrc = crc;
+	pendingSize = size;
+	pending.clear();
+	pending.reserve(compSize);
+	return true;
+}
+
+bool PackageInstaller::writeCompressed(const char* data, size_t len)
+{
+	pending.append(data, len);
+	return true;
+}
+
+bool PackageInstaller::endCompressed()
+{
+	// the pipeline fails the whole install if the data doesn't match this
+	if (tracked(pendingName))
+		fileCrcs[pendingName] = pendingCrc;
+
+	return pipeline.submit(pendingPath, pendingMethod, pendingCrc, pendingSize, std::move(pending));
+}
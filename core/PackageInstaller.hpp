@@ -0,0 +1,150 @@
+#ifndef PACKAGEINSTALLER_H_
+#define PACKAGEINSTALLER_H_
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../libs/get/src/Get.hpp"
+
+#include "ConnectionPool.hpp"
+#include "ExtractPipeline.hpp"
+#include "IndexDigests.hpp"
+#include "InstallJournal.hpp"
+#include "InstalledDB.hpp"
+#include "PackagePrefetch.hpp"
+#include "RangeDownload.hpp"
+#include "StreamHash.hpp"
+#include "ZipStream.hpp"
+
+// parallel byte ranges used for a package zip when segmented downloads are on
+#define DOWNLOAD_SEGMENTS 4
+
+// changed entries closer together than this are fetched in one range (with the unchanged ones in between skipped)
+#define DELTA_GAP 0x8000
+
+// above this share of the archive, a delta update just downloads the whole zip instead
+#define DELTA_MAX_PERCENT 70
+
+// Installs a package by inflating its zip entries onto the SD card while the archive downloads,
+// leaving the same files behind as get->install. Updates only fetch the entries that changed.
+// Everything is staged in the temp folder and checked against the repo's digests, then moved
+// into place by an InstallJournal commit and recorded in the InstalledDB. Package statuses
+// aren't reloaded here, callers do that with get->update() once it's safe to.
+class PackageInstaller : public ZipEntrySink
+{
+public:
+	static bool install(Get* get, Package& package);
+
+	// same, from a zip that was already downloaded (the caller reports status)
+	static bool installFromFile(Get* get, Package& package, const std::string& zipPath);
+
+	// checks installed files against their recorded crcs, returns how many were checked
+	// (-1 if the install has no record) and fills in the paths of missing or changed ones
+	static int verify(Get* get, const Package& package, std::vector<std::string>* damaged);
+
+	// when > 1, zips are fetched to the temp folder in that many ranges and extracted after
+	static int downloadSegments;
+
+	// streams a zip into a folder the way installs download and extract it (see tools/test_downloads.sh)
+	static bool extractUrl(const std::string& url, const std::string& folder);
+
+	bool beginEntry(const std::string& name, uint64_t size);
+	bool writeEntry(const char* data, size_t len);
+	bool endEntry(bool valid);
+
+	bool beginCompressed(const std::string& name, uint16_t method, uint32_t crc, uint64_t compSize, uint64_t size);
+	bool writeCompressed(const char* data, size_t len);
+	bool endCompressed();
+
+private:
+	PackageInstaller(Get* get, Package& package);
+
+	bool run();
+	void loadManifest();
+	bool download();
+	bool downloadSegmented();
+	bool extractFile(const std::string& path);
+	bool feedArchive(const char* data, size_t len);
+	bool checkDigest();
+
+	bool planDelta();
+	bool downloadDelta();
+	bool fetchRange(const std::string& range, std::string* buffer);
+	void removeStaleFiles();
+	static bool sameFile(const std::string& path, uint64_t size, uint32_t crc);
+	bool writeMetadata();
+	void writeChecksums();
+	void recordInstall();
+
+	// where a zip entry should be written, or an empty string to skip it
+	std::string destinationFor(const std::string& name);
+	bool wantsEntry(const std::string& name);
+	bool tracked(const std::string& name);
+
+#ifndef NETWORK_MOCK
+	// feeds url to zip through write, resuming a dropped transfer where the stream stopped
+	static bool streamZip(const std::string& url, ZipStream& zip, curl_write_callback write, curl_xferinfo_callback progress, void* userp, uint64_t* resumeOffset);
+
+	static size_t onData(char* data, size_t size, size_t nmemb, void* userp);
+	static size_t onBuffer(char* data, size_t size, size_t nmemb, void* userp);
+	static int onProgress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+#endif
+
+	Get* get;
+	Package& package;
+	std::string pkgDir;
+
+	// zip path -> manifest operation (U, E, G, L), from the remote manifest.install
+	std::unordered_map<std::string, char> operations;
+
+	// same, from the installed manifest.install before this update
+	std::unordered_map<std::string, char> previousOperations;
+	std::string manifestData;
+	bool zipHadManifest = false;
+
+	// zip path -> crc of every installed file that verify can check, carried over between updates
+	std::unordered_map<std::string, uint32_t> fileCrcs;
+	std::string currentEntry;
+
+	// what the repo index says the zip should hash to, checked when the whole archive streams through
+	PackageDigest expected;
+	StreamHash archiveHash;
+	bool hashing = false;
+
+	ZipStream zip;
+	std::string zipPath;
+	bool localZip = false;
+
+	// bytes received before the current transfer, when it resumed a dropped one
+	uint64_t resumeOffset = 0;
+
+	// the start of the zip from an unfinished prefetch, streamed before the rest is downloaded,
+	// and whether that's what failed (so the install can start over without it)
+	std::string partialZip;
+	bool resumeFailed = false;
+
+	// archive byte ranges (start, end exclusive) and entry names a delta update fetches
+	bool delta = false;
+	std::vector<std::pair<uint64_t, uint64_t>> deltaRanges;
+	std::unordered_set<std::string> deltaEntries;
+	uint64_t deltaBytes = 0;
+
+	// every file is written to its staged path, declared first so the pipeline stops writing before it's discarded
+	InstallJournal journal;
+
+	// inflates and writes the extracted files
+	ExtractPipeline pipeline;
+
+	// the whole entry currently being received still compressed, for the pipeline
+	std::string pendingName;
+	std::string pendingPath;
+	uint16_t pendingMethod = 0;
+	uint32_t pendingCrc = 0;
+	uint64_t pendingSize = 0;
+	std::string pending;
+};
+
+#endif
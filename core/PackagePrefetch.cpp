@@ -0,0 +1,325 @@
+#include "PackagePrefetch.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sys/stat.h>
+
+#include "../libs/get/src/Utils.hpp"
+
+PackagePrefetch* PackagePrefetch::prefetch = nullptr;
+int64_t PackagePrefetch::budget = PREFETCH_BUDGET;
+
+void PackagePrefetch::init(Get* get)
+{
+	if (!prefetch)
+		prefetch = new PackagePrefetch(get);
+}
+
+void PackagePrefetch::quit()
+{
+	delete prefetch;
+	prefetch = nullptr;
+}
+
+PackagePrefetch::PackagePrefetch(Get* get)
+	: folder(get->mTmp_path + "prefetch/")
+{
+	mkpath(folder);
+
+	// what earlier sessions left, oldest first so they're the first to go
+	std::error_code error;
+	std::vector<std::pair<std::filesystem::file_time_type, Entry>> found;
+	std::filesystem::file_time_type partialTime;
+	for (auto& file : std::filesystem::directory_iterator(folder, error))
+	{
+		std::string path = file.path().string();
+		auto time = file.last_write_time(error);
+
+		// only the newest partial zip is kept to resume, as while running (none with prefetching off)
+		if (file.path().extension() == ".part")
+		{
+			if (budget <= 0 || (!partialPath.empty() && time < partialTime))
+			{
+				std::remove(path.c_str());
+				continue;
+			}
+
+			if (!partialPath.empty())
+				std::remove(partialPath.c_str());
+			partialPath = path;
+			partialTime = time;
+			continue;
+		}
+
+		if (file.path().extension() != ".zip")
+		{
+			std::remove(path.c_str());
+			continue;
+		}
+
+		found.push_back({ time, { path, (int64_t)file.file_size(error), 0 } });
+	}
+
+	std::sort(found.begin(), found.end(), [](auto& a, auto& b) { return a.first < b.first; });
+	for (auto& entry : found)
+	{
+		entry.second.lastUsed = useCounter++;
+		entries.push_back(entry.second);
+	}
+
+	evict(0);
+	worker = std::thread(&PackagePrefetch::run, this);
+}
+
+PackagePrefetch::~PackagePrefetch()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	worker.join();
+}
+
+std::string PackagePrefetch::cachePath(const std::string& name, const std::string& version)
+{
+	// a different version is a different zip, old ones just age out
+	return folder + name + "-" + replaceAll(version, "/", "_") + ".zip";
+}
+
+void PackagePrefetch::request(const Package& package)
+{
+	if (budget <= 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending = true;
+		pendingUrl = package.getZipUrl();
+		pendingPath = cachePath(package.getPackageName(), package.getVersion());
+	}
+	wake.notify_all();
+}
+
+bool PackagePrefetch::take(const Package& package, std::string* path)
+{
+	std::string cached = cachePath(package.getPackageName(), package.getVersion());
+
+	std::lock_guard<std::mutex> guard(lock);
+	for (auto entry = entries.begin(); entry != entries.end(); entry++)
+	{
+		if (entry->path != cached)
+			continue;
+
+		entries.erase(entry);
+		*path = cached;
+		return true;
+	}
+
+	return false;
+}
+
+bool PackagePrefetch::takePartial(const Package& package, std::string* path)
+{
+	std::string cached = cachePath(package.getPackageName(), package.getVersion());
+	std::string part = cached + ".part";
+
+	std::unique_lock<std::mutex> guard(lock);
+
+	// it's being installed now, so there's no point starting it
+	if (pending && pendingPath == cached)
+		pending = false;
+
+	// the download has to stop writing to it first
+	if (downloading == part)
+	{
+		handingOff = part;
+		wake.wait(guard, [&] { return downloading != part; });
+		handingOff.clear();
+	}
+
+	if (partialPath != part)
+		return false;
+
+	// moved aside, so prefetching the package again can't write over it
+	std::string resume = cached + ".resume";
+	partialPath.clear();
+	if (std::rename(part.c_str(), resume.c_str()) != 0)
+		return false;
+
+	*path = resume;
+	return true;
+}
+
+void PackagePrefetch::run()
+{
+	while (true)
+	{
+		std::string url, path;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return pending || stopping; });
+			if (stopping)
+				break;
+
+			url = pendingUrl;
+			path = pendingPath;
+			pending = false;
+
+			// already cached, it just counts as used again
+			bool cached = false;
+			for (auto& entry : entries)
+				if (entry.path == path)
+				{
+					entry.lastUsed = useCounter++;
+					cached = true;
+				}
+
+			if (cached)
+				continue;
+
+			downloading = path + ".part";
+		}
+
+		bool done = download(url, path);
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			downloading.clear();
+		}
+		wake.notify_all();
+
+		if (done)
+			printf("--> Prefetched %s\n", path.c_str());
+	}
+}
+
+bool PackagePrefetch::download(const std::string& url, const std::string& path)
+{
+	// only one partial zip is kept, for whichever package was prefetched last
+	std::string part = path + ".part";
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!partialPath.empty() && partialPath != part)
+			std::remove(partialPath.c_str());
+		partialPath = part;
+	}
+
+	struct stat info;
+	written = stat(part.c_str(), &info) == 0 ? info.st_size : 0;
+
+#ifndef NETWORK_MOCK
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		file = fopen(part.c_str(), written > 0 ? "ab" : "wb");
+		if (!file)
+			return false;
+
+		CURL* curl = ConnectionPool::pool->acquire(url, PRIORITY_PREFETCH);
+		if (!curl)
+		{
+			fclose(file);
+			return false;
+		}
+
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PackagePrefetch::onData);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+		curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+		curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, PackagePrefetch::onProgress);
+		curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+		if (written > 0)
+			curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)written);
+
+		CURLcode res = curl_easy_perform(curl);
+		ConnectionPool::pool->release(curl);
+		fclose(file);
+		file = nullptr;
+
+		if (res == CURLE_OK)
+			break;
+
+		// the server can't resume, so start over once
+		if (res == CURLE_RANGE_ERROR && written > 0)
+		{
+			std::remove(part.c_str());
+			written = 0;
+			continue;
+		}
+
+		// stopped for higher priority work or the budget, what's there so far is resumed next time
+		if (res != CURLE_ABORTED_BY_CALLBACK && res != CURLE_WRITE_ERROR)
+			printf("--> Couldn't prefetch %s: %s\n", url.c_str(), curl_easy_strerror(res));
+		if (res == CURLE_WRITE_ERROR)
+			std::remove(part.c_str());
+		return false;
+	}
+#else
+	std::string data;
+	if (!ConnectionPool::pool->fetch(url, &data, PRIORITY_PREFETCH) || (int64_t)data.size() > budget)
+		return false;
+
+	evict(data.size());
+	std::ofstream(part, std::ios::binary) << data;
+	written = data.size();
+#endif
+
+	if (std::rename(part.c_str(), path.c_str()) != 0)
+		return false;
+
+	std::lock_guard<std::mutex> guard(lock);
+	partialPath.clear();
+	entries.push_back({ path, written, useCounter++ });
+	return true;
+}
+
+void PackagePrefetch::evict(int64_t needed)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	int64_t total = needed;
+	for (auto& entry : entries)
+		total += entry.size;
+
+	// least recently used first
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+	while (total > budget && !entries.empty())
+	{
+		total -= entries.front().size;
+		std::remove(entries.front().path.c_str());
+		entries.erase(entries.begin());
+	}
+}
+
+#ifndef NETWORK_MOCK
+size_t PackagePrefetch::onData(char* data, size_t size, size_t nmemb, void* userp)
+{
+	auto prefetch = (PackagePrefetch*)userp;
+	size_t len = size * nmemb;
+
+	// a zip bigger than the whole budget is never going to fit
+	if (prefetch->written + (int64_t)len > budget)
+		return 0;
+
+	// make room as it grows, the size isn't always known up front
+	prefetch->evict(prefetch->written + len);
+
+	if (fwrite(data, 1, len, prefetch->file) != len)
+		return 0;
+
+	prefetch->written += len;
+	return len;
+}
+
+int PackagePrefetch::onProgress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+	auto prefetch = (PackagePrefetch*)clientp;
+
+	{
+		std::lock_guard<std::mutex> guard(prefetch->lock);
+		if (prefetch->stopping || prefetch->pending || !prefetch->handingOff.empty())
+			return 1;
+	}
+
+	return ConnectionPool::pool->preempted(PRIORITY_PREFETCH) ? 1 : 0;
+}
+#endif
@@ -0,0 +1,101 @@
+#ifndef PACKAGEPREFETCH_H_
+#define PACKAGEPREFETCH_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../libs/get/src/Get.hpp"
+
+#include "ConnectionPool.hpp"
+
+// how long (in ms) a details page has to stay open before its package is prefetched
+#define PREFETCH_DWELL_MS 1500
+
+// default for the most bytes of prefetched zips kept in the cache
+#if defined(_3DS) || defined(WII)
+#define PREFETCH_BUDGET (16 * 1024 * 1024)
+#else
+#define PREFETCH_BUDGET (128 * 1024 * 1024)
+#endif
+
+// Downloads a package's zip ahead of time, while the user is still looking at its details
+// page, so pressing Download/Update often only has to extract it. Prefetches use the
+// pool's prefetch priority: they wait for (and get cancelled by) anything more important,
+// and an interrupted one resumes where it stopped next time, or the install picks it up if
+// Download is pressed before it finishes. Finished zips are kept in a cache folder up to a
+// byte budget, and the least recently used ones are evicted first.
+class PackagePrefetch
+{
+public:
+	static PackagePrefetch* prefetch;
+
+	static void init(Get* get);
+	static void quit();
+
+	// most bytes the cache may hold, 0 turns prefetching off
+	static int64_t budget;
+
+	// start prefetching this package's zip in the background (replaces any earlier request)
+	void request(const Package& package);
+
+	// the prefetched zip for this exact version, moved out of the cache for the caller to
+	// install from and delete, false if there isn't a complete one
+	bool take(const Package& package, std::string* path);
+
+	// the start of this version's zip from a prefetch that didn't finish (stopping it first if it's
+	// still running), moved out of the cache for the caller to resume from and delete
+	bool takePartial(const Package& package, std::string* path);
+
+private:
+	PackagePrefetch(Get* get);
+	~PackagePrefetch();
+
+	struct Entry
+	{
+		std::string path;
+		int64_t size;
+		uint64_t lastUsed;
+	};
+
+	void run();
+	bool download(const std::string& url, const std::string& path);
+	void evict(int64_t needed);
+	std::string cachePath(const std::string& name, const std::string& version);
+
+#ifndef NETWORK_MOCK
+	static size_t onData(char* data, size_t size, size_t nmemb, void* userp);
+	static int onProgress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+#endif
+
+	std::string folder;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::thread worker;
+	bool stopping = false;
+
+	// the latest request that hasn't been started yet
+	bool pending = false;
+	std::string pendingUrl;
+	std::string pendingPath;
+
+	// finished zips in the cache, and a counter standing in for access times
+	std::vector<Entry> entries;
+	uint64_t useCounter = 0;
+
+	// the zip being written by the current download, its partial file stays around to resume
+	std::string partialPath;
+	FILE* file = nullptr;
+	int64_t written = 0;
+
+	// the partial file the worker is writing to, and the one takePartial is waiting on
+	std::string downloading;
+	std::string handingOff;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "PackageRemover.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <thread>
+
+#include "../libs/get/src/Utils.hpp"
+
+#include "ExtractPipeline.hpp"
+#include "InstalledDB.hpp"
+
+bool PackageRemover::remove(Get* get, const std::string& packageName)
+{
+	InstalledPackage installed;
+	if (!(InstalledDB::db ? InstalledDB::db->find(packageName, &installed) : InstalledDB::readFolder(get, packageName, &installed)))
+		return false;
+
+	// sorted, so neighbouring directories end up next to each other too
+	std::map<std::string, std::vector<std::string>> byDir;
+	for (auto& file : installed.files)
+	{
+		std::string path = ROOT_PATH + file.path;
+		byDir[path.substr(0, path.rfind('/'))].push_back(path);
+	}
+
+	std::vector<Group> groups(byDir.begin(), byDir.end());
+	int total = installed.files.size();
+
+	std::atomic<size_t> nextGroup { 0 };
+	std::atomic<int> removed { 0 };
+	std::atomic<int> failed { 0 };
+
+	auto work = [&]() {
+		size_t index;
+		while ((index = nextGroup++) < groups.size())
+		{
+			for (auto& path : groups[index].second)
+			{
+				// already gone is fine, an earlier attempt may have got to it
+				std::error_code error;
+				if (!std::filesystem::remove(path, error) && error)
+					failed++;
+				removed++;
+			}
+		}
+	};
+
+	int threadCount = std::min<int>(std::max(ExtractPipeline::defaultThreads(), 1), REMOVE_THREADS_MAX);
+	threadCount = std::min<int>(threadCount, groups.size());
+
+	std::vector<std::thread> workers;
+	for (int x = 0; x < threadCount; x++)
+		workers.emplace_back(work);
+
+	// the status callback has to come from this thread, so it only watches
+	int reported = -1;
+	while (removed < total)
+	{
+		int now = removed;
+		if (now != reported && libget_status_callback)
+			libget_status_callback(STATUS_REMOVING, now, total);
+		reported = now;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(REMOVE_PROGRESS_INTERVAL));
+	}
+
+	for (auto& worker : workers)
+		worker.join();
+
+	if (libget_status_callback)
+		libget_status_callback(STATUS_REMOVING, total, total);
+
+	pruneFolders(groups);
+
+	// without its folder and record, the files that are left would belong to nothing
+	if (failed > 0)
+	{
+		printf("--> Couldn't remove %d files of %s, it stays installed\n", (int)failed, packageName.c_str());
+		return false;
+	}
+
+	// the package folder (info.json, manifest, icon) goes last, it's what marks the package installed
+	std::error_code error;
+	std::filesystem::remove_all(get->mPkg_path + packageName, error);
+
+	printf("--> Removed %d files of %s\n", total, packageName.c_str());
+	return true;
+}
+
+bool PackageRemover::tracked(Get* get, const std::string& packageName)
+{
+	InstalledPackage installed;
+	return InstalledDB::db ? InstalledDB::db->find(packageName, &installed) : InstalledDB::readFolder(get, packageName, &installed);
+}
+
+void PackageRemover::pruneFolders(const std::vector<Group>& groups)
+{
+	std::string root(ROOT_PATH);
+
+	// every folder the package had files in, and their parents up to the root
+	std::vector<std::string> folders;
+	for (auto& group : groups)
+	{
+		std::string dir = group.first;
+		while (dir.size() > root.size() && dir.compare(0, root.size(), root) == 0)
+		{
+			folders.push_back(dir);
+			dir = dir.substr(0, dir.rfind('/'));
+		}
+	}
+
+	// deepest first, so a folder is only tried once everything under it was
+	std::sort(folders.begin(), folders.end(), [](const std::string& a, const std::string& b) {
+		auto depthA = std::count(a.begin(), a.end(), '/');
+		auto depthB = std::count(b.begin(), b.end(), '/');
+		return depthA != depthB ? depthA > depthB : a < b;
+	});
+	folders.erase(std::unique(folders.begin(), folders.end()), folders.end());
+
+	// only succeeds on folders that are empty now
+	for (auto& folder : folders)
+	{
+		std::error_code error;
+		std::filesystem::remove(folder, error);
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef PACKAGEREMOVER_H_
+#define PACKAGEREMOVER_H_
+
+#include <string>
+#include <vector>
+
+#include "../libs/get/src/Get.hpp"
+
+// most unlinks in flight at once, past this the SD card just queues them up
+#define REMOVE_THREADS_MAX 4
+
+// how often (in ms) removal progress is passed to the status callback
+#define REMOVE_PROGRESS_INTERVAL 30
+
+// Removes an installed package from the SD card, replacing get->remove's one file at a
+// time walk of the manifest. The files are grouped by directory and a small pool of workers
+// takes whole directories at a time (so FAT directory lookups stay warm), then the folders
+// they leave empty are removed in one bottom-up pass. Progress goes to libget's status
+// callback as STATUS_REMOVING. Package statuses aren't reloaded, same as PackageInstaller.
+class PackageRemover
+{
+public:
+	// false if some files couldn't be removed (the package and its record are kept, so it can
+	// be tried again), or if there's no record of what it installed (get->remove works then)
+	static bool remove(Get* get, const std::string& packageName);
+
+	// whether there's a record of what the package installed
+	static bool tracked(Get* get, const std::string& packageName);
+
+private:
+	// each directory with every file to remove in it
+	typedef std::pair<std::string, std::vector<std::string>> Group;
+
+	static void pruneFolders(const std::vector<Group>& groups);
+};
+
+#endif
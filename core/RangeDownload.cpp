@@ -0,0 +1,359 @@
+#include "RangeDownload.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "../libs/get/src/Utils.hpp"
+
+RangeDownload::RangeDownload(const std::string& url, const std::string& path, int segments)
+	: url(url)
+	, path(path)
+	, partPath(path + ".part")
+	, rangesPath(path + ".part.ranges")
+	, segmentCount(std::max(1, segments))
+{
+}
+
+RangeDownload::~RangeDownload()
+{
+#ifndef NETWORK_MOCK
+	for (auto& segment : segments)
+		stopSegment(segment);
+
+	if (multi)
+		curl_multi_cleanup(multi);
+#endif
+}
+
+bool RangeDownload::hasPartial(const std::string& path)
+{
+	struct stat buffer;
+	return stat((path + ".part.ranges").c_str(), &buffer) == 0;
+}
+
+uint64_t RangeDownload::downloaded() const
+{
+	uint64_t sum = 0;
+	for (auto& segment : segments)
+		sum += segment.done;
+	return sum;
+}
+
+#ifndef NETWORK_MOCK
+size_t RangeDownload::onHeader(char* data, size_t size, size_t nmemb, void* userp)
+{
+	auto download = (RangeDownload*)userp;
+	size_t len = size * nmemb;
+
+	std::string header(data, len);
+	if (strncasecmp(header.c_str(), "accept-ranges:", 14) == 0 && header.find("bytes") != std::string::npos)
+		download->acceptsRanges = true;
+
+	return len;
+}
+
+size_t RangeDownload::onData(char* data, size_t size, size_t nmemb, void* userp)
+{
+	auto segment = (Segment*)userp;
+	auto download = segment->owner;
+	size_t len = size * nmemb;
+
+	// a server that ignores our range sends the file from the start, which we can't use
+	long code = 0;
+	curl_easy_getinfo(segment->curl, CURLINFO_RESPONSE_CODE, &code);
+	if (code != 206 && segment->start + segment->done != 0)
+		return 0;
+
+	// a response that runs past the segment would write over the next one, keep only what fits
+	size_t fits = len;
+	if (segment->end != UINT64_MAX)
+		fits = std::min<uint64_t>(len, segment->end - segment->start - segment->done);
+
+	if (fwrite(data, 1, fits, segment->file) != fits)
+		return 0;
+
+	segment->done += fits;
+	download->unsavedBytes += fits;
+
+	if (download->unsavedBytes >= RANGE_SAVE_INTERVAL)
+		download->saveProgress();
+
+	if (fits < len)
+	{
+		printf("--> Server sent more than was asked for of %s, stopping that segment\n", download->url.c_str());
+		return 0;
+	}
+
+	return len;
+}
+#endif
+
+bool RangeDownload::probe()
+{
+#ifndef NETWORK_MOCK
+	CURL* curl = ConnectionPool::pool->acquire(url, PRIORITY_INSTALL);
+	if (!curl)
+		return false;
+
+	curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, RangeDownload::onHeader);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+
+	CURLcode res = curl_easy_perform(curl);
+
+	curl_off_t length = -1;
+	curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+	ConnectionPool::pool->release(curl);
+
+	if (res != CURLE_OK || length <= 0)
+	{
+		// no size to plan ranges around, fall back to one plain stream
+		acceptsRanges = false;
+		total = 0;
+		return res == CURLE_OK;
+	}
+
+	total = length;
+#endif
+	return true;
+}
+
+bool RangeDownload::loadProgress()
+{
+	if (!acceptsRanges || !hasPartial(path))
+		return false;
+
+	std::ifstream ranges(rangesPath);
+	uint64_t savedTotal = 0;
+	ranges >> savedTotal;
+
+	// the file changed on the server since, so that progress is useless
+	if (savedTotal != total)
+		return false;
+
+	Segment segment;
+	while (ranges >> segment.start >> segment.end >> segment.done)
+		segments.push_back(segment);
+
+	if (segments.empty())
+		return false;
+
+	printf("--> Resuming %s at %llu/%llu bytes\n", url.c_str(), (unsigned long long)downloaded(), (unsigned long long)total);
+	return true;
+}
+
+void RangeDownload::saveProgress()
+{
+	unsavedBytes = 0;
+
+	// without range support, partial progress can't be resumed anyway
+	if (!acceptsRanges)
+		return;
+
+	// make sure what the ranges file claims is actually on disk
+	for (auto& segment : segments)
+		if (segment.file)
+			fflush(segment.file);
+
+	std::ofstream ranges(rangesPath, std::ios::trunc);
+	ranges << total << "\n";
+	for (auto& segment : segments)
+		ranges << segment.start << " " << segment.end << " " << segment.done << "\n";
+}
+
+void RangeDownload::planSegments()
+{
+	segments.clear();
+
+	if (total == 0)
+	{
+		// unknown size, one open ended stream
+		Segment segment;
+		segment.start = 0;
+		segment.end = UINT64_MAX;
+		segments.push_back(segment);
+		return;
+	}
+
+	int count = (acceptsRanges && total >= SEGMENT_MIN_SIZE) ? segmentCount : 1;
+	uint64_t size = total / count;
+
+	for (int x = 0; x < count; x++)
+	{
+		Segment segment;
+		segment.start = x * size;
+		segment.end = (x == count - 1) ? total : (x + 1) * size;
+		segments.push_back(segment);
+	}
+}
+
+#ifndef NETWORK_MOCK
+bool RangeDownload::startSegment(Segment& segment)
+{
+	segment.owner = this;
+	segment.file = fopen(partPath.c_str(), "r+b");
+	if (!segment.file)
+		return false;
+
+	fseek(segment.file, segment.start + segment.done, SEEK_SET);
+
+	segment.curl = ConnectionPool::pool->acquire(url, PRIORITY_INSTALL);
+	if (!segment.curl)
+		return false;
+
+	if (acceptsRanges)
+	{
+		std::string range = std::to_string(segment.start + segment.done) + "-";
+		if (segment.end != UINT64_MAX)
+			range += std::to_string(segment.end - 1);
+		curl_easy_setopt(segment.curl, CURLOPT_RANGE, range.c_str());
+	}
+
+	curl_easy_setopt(segment.curl, CURLOPT_WRITEFUNCTION, RangeDownload::onData);
+	curl_easy_setopt(segment.curl, CURLOPT_WRITEDATA, &segment);
+	curl_easy_setopt(segment.curl, CURLOPT_PRIVATE, &segment);
+
+	// a segment that stalls is dropped and resumed, rather than hanging the whole download
+	curl_easy_setopt(segment.curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+	curl_easy_setopt(segment.curl, CURLOPT_LOW_SPEED_TIME, 20L);
+
+	curl_multi_add_handle(multi, segment.curl);
+	return true;
+}
+
+void RangeDownload::stopSegment(Segment& segment)
+{
+	if (segment.curl)
+	{
+		curl_multi_remove_handle(multi, segment.curl);
+		ConnectionPool::pool->release(segment.curl);
+		segment.curl = nullptr;
+	}
+
+	if (segment.file)
+	{
+		fclose(segment.file);
+		segment.file = nullptr;
+	}
+}
+#endif
+
+bool RangeDownload::finalize()
+{
+	std::remove(rangesPath.c_str());
+	std::remove(path.c_str());
+
+	if (std::rename(partPath.c_str(), path.c_str()) != 0)
+	{
+		printf("--> Couldn't move %s into place\n", partPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool RangeDownload::run()
+{
+#ifndef NETWORK_MOCK
+	if (!probe())
+		return false;
+
+	if (!loadProgress())
+	{
+		std::remove(partPath.c_str());
+		planSegments();
+	}
+
+	// the segments all open the part file for update, so it has to exist
+	FILE* create = fopen(partPath.c_str(), "ab");
+	if (!create)
+		return false;
+	fclose(create);
+
+	multi = curl_multi_init();
+
+	bool failed = false;
+	for (auto& segment : segments)
+	{
+		bool complete = segment.end != UINT64_MAX && segment.done >= segment.end - segment.start;
+		if (!complete && !startSegment(segment))
+			failed = true;
+	}
+
+	int active = 1;
+	while (active > 0 && !failed)
+	{
+		int running = 0;
+		curl_multi_perform(multi, &running);
+
+		CURLMsg* msg;
+		int left;
+		while ((msg = curl_multi_info_read(multi, &left)))
+		{
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+
+			Segment* segment = nullptr;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &segment);
+			CURLcode res = msg->data.result;
+			stopSegment(*segment);
+
+			bool complete = (segment->end == UINT64_MAX) ? res == CURLE_OK : segment->done >= segment->end - segment->start;
+			if (complete)
+				continue;
+
+			if (++segment->attempts > RANGE_RETRIES)
+			{
+				printf("--> Giving up on %s: %s\n", url.c_str(), curl_easy_strerror(res));
+				failed = true;
+				break;
+			}
+
+			// without range support, the only way to retry is from the start
+			if (!acceptsRanges)
+				segment->done = 0;
+
+			printf("--> Download of %s dropped (%s), resuming at %llu\n", url.c_str(), curl_easy_strerror(res),
+				(unsigned long long)(segment->start + segment->done));
+
+			if (!startSegment(*segment))
+				failed = true;
+		}
+
+		// progress covers every segment, and a non-zero return cancels like any other curl callback
+		if (onProgress)
+			failed |= onProgress(downloaded(), total) != 0;
+		else if (networking_callback)
+			failed |= networking_callback(nullptr, total, downloaded(), 0, 0) != 0;
+
+		active = 0;
+		for (auto& segment : segments)
+			active += segment.curl != nullptr;
+
+		if (active > 0 && !failed)
+			curl_multi_poll(multi, NULL, 0, 100, NULL);
+	}
+
+	for (auto& segment : segments)
+		stopSegment(segment);
+
+	// keep what we have so the next attempt picks up where this one stopped
+	saveProgress();
+
+	if (failed)
+		return false;
+
+	return finalize();
+#else
+	std::string data;
+	if (!ConnectionPool::pool->fetch(url, &data, PRIORITY_INSTALL))
+		return false;
+
+	std::ofstream file(path, std::ios::binary);
+	file << data;
+	return file.good();
+#endif
+}
@@ -0,0 +1,86 @@
+#ifndef RANGEDOWNLOAD_H_
+#define RANGEDOWNLOAD_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ConnectionPool.hpp"
+
+// files smaller than this are never split into segments
+#define SEGMENT_MIN_SIZE (8 * 1024 * 1024)
+
+// how many times a dropped segment is picked back up before giving up
+#define RANGE_RETRIES 5
+
+// how often (in bytes) segment progress is written to the .ranges file
+#define RANGE_SAVE_INTERVAL (1024 * 1024)
+
+// Downloads a file to disk so that a dropped connection doesn't mean starting over.
+// Data goes into "<path>.part", and per-segment progress into "<path>.part.ranges".
+// Failed segments are resumed with Range requests, either right away or by a later
+// download of the same file (even after a restart). Large files can optionally be
+// split into several byte ranges that download in parallel into the same file.
+class RangeDownload
+{
+public:
+	RangeDownload(const std::string& url, const std::string& path, int segments = 1);
+	~RangeDownload();
+
+	// blocks until the file is complete at path, or fails for good
+	bool run();
+
+	// whether a previous run left partial progress for this path
+	static bool hasPartial(const std::string& path);
+
+	uint64_t total = 0;
+	uint64_t downloaded() const;
+
+	// called with (downloaded, total) instead of networking_callback when set, non-zero cancels
+	std::function<int(uint64_t, uint64_t)> onProgress;
+
+private:
+	struct Segment
+	{
+		uint64_t start;
+		uint64_t end; // exclusive
+		uint64_t done = 0;
+
+		RangeDownload* owner = nullptr;
+		FILE* file = nullptr;
+		int attempts = 0;
+#ifndef NETWORK_MOCK
+		CURL* curl = nullptr;
+#endif
+	};
+
+	bool probe();
+	bool loadProgress();
+	void saveProgress();
+	void planSegments();
+	bool finalize();
+
+#ifndef NETWORK_MOCK
+	bool startSegment(Segment& segment);
+	void stopSegment(Segment& segment);
+
+	static size_t onHeader(char* data, size_t size, size_t nmemb, void* userp);
+	static size_t onData(char* data, size_t size, size_t nmemb, void* userp);
+
+	CURLM* multi = nullptr;
+#endif
+
+	std::string url;
+	std::string path;
+	std::string partPath;
+	std::string rangesPath;
+	int segmentCount;
+
+	bool acceptsRanges = false;
+	uint64_t unsavedBytes = 0;
+	std::vector<Segment> segments;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "StreamHash.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAS_CRC_INSTRUCTIONS
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#define HAS_SHA_INSTRUCTIONS
+#endif
+
+// file reads for crcFile
+#define HASH_READ_CHUNK 0x10000
+
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+StreamHash::StreamHash(bool sha256)
+	: useSha(sha256)
+{
+	static const uint32_t initial[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	memcpy(state, initial, sizeof(state));
+}
+
+uint32_t StreamHash::updateCrc(uint32_t crc, const void* data, size_t len)
+{
+#ifdef HAS_CRC_INSTRUCTIONS
+	// same polynomial as zlib, eight bytes per instruction
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint32_t c = ~crc;
+
+	while (len > 0 && ((uintptr_t)bytes & 7))
+	{
+		c = __crc32b(c, *bytes++);
+		len--;
+	}
+
+	for (; len >= 8; bytes += 8, len -= 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes, 8);
+		c = __crc32d(c, word);
+	}
+
+	while (len-- > 0)
+		c = __crc32b(c, *bytes++);
+
+	return ~c;
+#else
+	return crc32(crc, (const Bytef*)data, len);
+#endif
+}
+
+bool StreamHash::crcFile(const std::string& path, uint32_t* crc, uint64_t* size)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	std::vector<char> chunk(HASH_READ_CHUNK);
+	uint32_t sum = 0;
+	uint64_t read = 0;
+	size_t len;
+	while ((len = fread(chunk.data(), 1, chunk.size(), file)) > 0)
+	{
+		sum = updateCrc(sum, chunk.data(), len);
+		read += len;
+	}
+
+	bool ok = !ferror(file);
+	fclose(file);
+
+	*crc = sum;
+	if (size)
+		*size = read;
+	return ok;
+}
+
+void StreamHash::update(const char* data, size_t len)
+{
+	crcValue = updateCrc(crcValue, data, len);
+	total += len;
+
+	if (!useSha)
+		return;
+
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	// top up a partial block first
+	if (buffered > 0)
+	{
+		size_t take = std::min(len, sizeof(buffer) - buffered);
+		memcpy(buffer + buffered, bytes, take);
+		buffered += take;
+		bytes += take;
+		len -= take;
+
+		if (buffered < sizeof(buffer))
+			return;
+
+		compress(buffer, 1);
+		buffered = 0;
+	}
+
+	// whole blocks straight from the caller's data
+	compress(bytes, len / 64);
+	bytes += len - len % 64;
+	len %= 64;
+
+	memcpy(buffer, bytes, len);
+	buffered = len;
+}
+
+std::string StreamHash::sha256()
+{
+	if (!useSha)
+		return "";
+
+	// padding: a 1 bit, zeros, then the length in bits as a big endian 64-bit number
+	uint64_t bits = total * 8;
+	uint8_t pad[72] = { 0x80 };
+	size_t padLen = (buffered < 56 ? 56 : 120) - buffered;
+	for (int x = 0; x < 8; x++)
+		pad[padLen + x] = (uint8_t)(bits >> (56 - 8 * x));
+
+	// update() would also count these bytes towards the crc and size
+	uint32_t crc = crcValue;
+	uint64_t size = total;
+	update((const char*)pad, padLen + 8);
+	crcValue = crc;
+	total = size;
+	useSha = false;
+
+	char hex[65];
+	for (int x = 0; x < 8; x++)
+		snprintf(hex + x * 8, 9, "%08x", state[x]);
+	return hex;
+}
+
+#ifdef HAS_SHA_INSTRUCTIONS
+
+void StreamHash::compress(const uint8_t* blocks, size_t count)
+{
+	uint32x4_t abcd = vld1q_u32(&state[0]);
+	uint32x4_t efgh = vld1q_u32(&state[4]);
+
+	for (; count > 0; count--, blocks += 64)
+	{
+		uint32x4_t abcdSaved = abcd;
+		uint32x4_t efghSaved = efgh;
+
+		uint32x4_t msg[4];
+		for (int x = 0; x < 4; x++)
+			msg[x] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + x * 16)));
+
+		// four rounds per step, the message schedule runs three steps ahead
+		for (int x = 0; x < 16; x++)
+		{
+			uint32x4_t words = vaddq_u32(msg[x % 4], vld1q_u32(&K[x * 4]));
+			uint32x4_t previous = abcd;
+			abcd = vsha256hq_u32(abcd, efgh, words);
+			efgh = vsha256h2q_u32(efgh, previous, words);
+
+			if (x < 12)
+				msg[x % 4] = vsha256su1q_u32(vsha256su0q_u32(msg[x % 4], msg[(x + 1) % 4]), msg[(x + 2) % 4], msg[(x + 3) % 4]);
+		}
+
+		abcd = vaddq_u32(abcd, abcdSaved);
+		efgh = vaddq_u32(efgh, efghSaved);
+	}
+
+	vst1q_u32(&state[0], abcd);
+	vst1q_u32(&state[4], efgh);
+}
+
+#else
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+void StreamHash::compress(const uint8_t* blocks, size_t count)
+{
+	for (; count > 0; count--, blocks += 64)
+	{
+		uint32_t w[64];
+		for (int x = 0; x < 16; x++)
+			w[x] = (uint32_t)blocks[x * 4] << 24 | (uint32_t)blocks[x * 4 + 1] << 16 | (uint32_t)blocks[x * 4 + 2] << 8 | blocks[x * 4 + 3];
+
+		for (int x = 16; x < 64; x++)
+		{
+			uint32_t s0 = ROTR(w[x - 15], 7) ^ ROTR(w[x - 15], 18) ^ (w[x - 15] >> 3);
+			uint32_t s1 = ROTR(w[x - 2], 17) ^ ROTR(w[x - 2], 19) ^ (w[x - 2] >> 10);
+			w[x] = w[x - 16] + s0 + w[x - 7] + s1;
+		}
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int x = 0; x < 64; x++)
+		{
+			uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[x] + w[x];
+			uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef STREAMHASH_H_
+#define STREAMHASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Incremental CRC32 and (optionally) SHA-256 of a byte stream, updated with each chunk
+// as it arrives so nothing has to be read a second time. Both use the CPU's crc/sha
+// instructions when the target has them (eg. the Switch's ARMv8 crypto extensions),
+// and portable code otherwise.
+class StreamHash
+{
+public:
+	StreamHash(bool sha256 = true);
+
+	void update(const char* data, size_t len);
+
+	uint32_t crc() const { return crcValue; }
+	uint64_t size() const { return total; }
+
+	// lowercase hex digest of everything so far (empty if sha256 is off), ends the stream
+	std::string sha256();
+
+	// same as zlib's crc32(), but using the crc instructions where available
+	static uint32_t updateCrc(uint32_t crc, const void* data, size_t len);
+
+	// crc32 (and size) of a file on disk, false if it couldn't be read
+	static bool crcFile(const std::string& path, uint32_t* crc, uint64_t* size = nullptr);
+
+private:
+	void compress(const uint8_t* blocks, size_t count);
+
+	bool useSha;
+	uint32_t crcValue = 0;
+	uint64_t total = 0;
+
+	uint32_t state[8];
+	uint8_t buffer[64];
+	size_t buffered = 0;
+};
+
+#endif
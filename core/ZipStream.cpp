@@ -0,0 +1,637 @@
+#include "ZipStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "StreamHash.hpp"
+
+#define SIG_LOCAL_HEADER 0x04034b50
+#define SIG_CENTRAL_DIR 0x02014b50
+#define SIG_END_OF_CENTRAL_DIR 0x06054b50
+#define SIG_DATA_DESCRIPTOR 0x08074b50
+
+#define LOCAL_HEADER_SIZE 30
+#define CENTRAL_DIR_SIZE 46
+#define END_OF_CENTRAL_DIR_SIZE 22
+
+#define FLAG_ENCRYPTED 0x1
+#define FLAG_DATA_DESCRIPTOR 0x8
+
+#define METHOD_STORED 0
+#define METHOD_DEFLATED 8
+
+#define ZIP64_EXTRA_ID 0x0001
+
+static uint16_t read16(const char* p)
+{
+	auto u = (const uint8_t*)p;
+	return u[0] | (u[1] << 8);
+}
+
+static uint32_t read32(const char* p)
+{
+	auto u = (const uint8_t*)p;
+	return u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t)u[3] << 24);
+}
+
+static uint64_t read64(const char* p)
+{
+	return read32(p) | ((uint64_t)read32(p + 4) << 32);
+}
+
+// look up the zip64 extended sizes in an extra field, if present
+static bool readZip64Sizes(const char* extra, size_t extraLen, uint64_t* size, uint64_t* compSize)
+{
+	size_t pos = 0;
+	while (pos + 4 <= extraLen)
+	{
+		uint16_t id = read16(extra + pos);
+		uint16_t len = read16(extra + pos + 2);
+		if (id == ZIP64_EXTRA_ID && len >= 16 && pos + 4 + len <= extraLen)
+		{
+			*size = read64(extra + pos + 4);
+			*compSize = read64(extra + pos + 12);
+			return true;
+		}
+		pos += 4 + len;
+	}
+	return false;
+}
+
+// finds the end of central directory record, which is in the last 64k + 22 bytes (max comment length)
+static bool readEndOfCentralDir(FILE* file, uint16_t* count, uint32_t* cdSize, uint32_t* cdOffset, long* position)
+{
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+
+	long tailSize = std::min(fileSize, (long)(0xFFFF + END_OF_CENTRAL_DIR_SIZE));
+	std::vector<char> tail(tailSize);
+	fseek(file, fileSize - tailSize, SEEK_SET);
+	if (fread(tail.data(), 1, tailSize, file) != (size_t)tailSize)
+		return false;
+
+	for (long i = tailSize - END_OF_CENTRAL_DIR_SIZE; i >= 0; i--)
+	{
+		if (read32(&tail[i]) != SIG_END_OF_CENTRAL_DIR)
+			continue;
+
+		*count = read16(&tail[i + 10]);
+		*cdSize = read32(&tail[i + 12]);
+		*cdOffset = read32(&tail[i + 16]);
+		if (position)
+			*position = fileSize - tailSize + i;
+		return true;
+	}
+
+	return false;
+}
+
+ZipStream::ZipStream(ZipEntrySink* sink, const std::string& spillPath)
+	: sink(sink)
+	, spillPath(spillPath)
+{
+	memset(&inflater, 0, sizeof(inflater));
+	chunk = new char[ZIP_INFLATE_CHUNK];
+}
+
+ZipStream::~ZipStream()
+{
+	if (inflaterReady)
+		inflateEnd(&inflater);
+
+	delete[] chunk;
+
+	if (spill)
+	{
+		fclose(spill);
+		std::remove(spillPath.c_str());
+	}
+}
+
+bool ZipStream::fail(const std::string& reason)
+{
+	if (state != FAILED)
+		printf("--> Couldn't extract archive: %s\n", reason.c_str());
+
+	error = reason;
+	state = FAILED;
+	return false;
+}
+
+bool ZipStream::feed(const char* data, size_t len)
+{
+	while (len > 0 && state != FAILED)
+	{
+		size_t used = 0;
+
+		switch (state)
+		{
+			case LOCAL_HEADER:
+				used = feedHeader(data, len);
+				break;
+			case ENTRY_DATA:
+				used = feedEntryData(data, len);
+				break;
+			case DATA_DESCRIPTOR:
+				used = feedDescriptor(data, len);
+				break;
+			case SPILLING:
+				used = feedSpill(data, len);
+				break;
+			case TRAILER:
+				// central directory, everything in it was already streamed
+				used = len;
+				break;
+			default:
+				break;
+		}
+
+		data += used;
+		len -= used;
+		offset += used;
+	}
+
+	return state != FAILED;
+}
+
+size_t ZipStream::feedHeader(const char* data, size_t len)
+{
+	// buffer the fixed part of the header first, then the name and extra field
+	size_t needed = LOCAL_HEADER_SIZE;
+	if (pending.size() >= LOCAL_HEADER_SIZE)
+		needed += read16(&pending[26]) + read16(&pending[28]);
+
+	size_t take = std::min(len, needed - pending.size());
+	pending.append(data, take);
+
+	if (pending.size() >= 4 && read32(pending.data()) != SIG_LOCAL_HEADER)
+	{
+		uint32_t sig = read32(pending.data());
+		pending.clear();
+
+		// no more local entries, the rest is the central directory
+		if (sig == SIG_CENTRAL_DIR || sig == SIG_END_OF_CENTRAL_DIR)
+			state = TRAILER;
+		else
+			fail("bad local header signature");
+
+		return take;
+	}
+
+	if (pending.size() < LOCAL_HEADER_SIZE)
+		return take;
+
+	uint16_t nameLen = read16(&pending[26]);
+	uint16_t extraLen = read16(&pending[28]);
+	if (pending.size() < (size_t)LOCAL_HEADER_SIZE + nameLen + extraLen)
+		return take;
+
+	uint16_t entryFlags = read16(&pending[6]);
+	uint16_t entryMethod = read16(&pending[8]);
+	uint32_t entryCrc = read32(&pending[14]);
+	uint64_t compSize = read32(&pending[18]);
+	uint64_t size = read32(&pending[22]);
+	std::string name = pending.substr(LOCAL_HEADER_SIZE, nameLen);
+
+	if (entryFlags & FLAG_ENCRYPTED)
+	{
+		fail("encrypted entry " + name);
+		return take;
+	}
+
+	if (entryMethod != METHOD_STORED && entryMethod != METHOD_DEFLATED)
+	{
+		fail("unsupported compression for " + name);
+		return take;
+	}
+
+	bool knownSizes = true;
+	if (compSize == 0xFFFFFFFF || size == 0xFFFFFFFF)
+		knownSizes = readZip64Sizes(&pending[LOCAL_HEADER_SIZE + nameLen], extraLen, &size, &compSize);
+
+	// a stored entry with a trailing data descriptor has no way to tell where
+	// it ends until we read the central directory, so spill from here onwards
+	bool unknownLength = (entryFlags & FLAG_DATA_DESCRIPTOR) && entryMethod == METHOD_STORED;
+
+	if (!knownSizes || unknownLength)
+	{
+		spill = fopen(spillPath.c_str(), "wb");
+		if (!spill)
+		{
+			fail("couldn't open spill file " + spillPath);
+			return take;
+		}
+
+		// the header we buffered is the first thing in the spill
+		spillStart = offset + take - pending.size();
+		fwrite(pending.data(), 1, pending.size(), spill);
+		pending.clear();
+
+		state = SPILLING;
+		return take;
+	}
+
+	pending.clear();
+	startEntry(name, entryMethod, entryFlags, entryCrc, compSize, size);
+
+	return take;
+}
+
+bool ZipStream::startEntry(const std::string& name, uint16_t entryMethod, uint16_t entryFlags, uint32_t entryCrc, uint64_t compSize, uint64_t size)
+{
+	method = entryMethod;
+	flags = entryFlags;
+	expectedCrc = entryCrc;
+	crc = 0;
+	compRead = 0;
+
+	// entries with a data descriptor run until the deflate stream ends
+	compRemaining = (flags & FLAG_DATA_DESCRIPTOR) ? UINT64_MAX : compSize;
+
+	// the sink can take entries of a known length as they are, to inflate them elsewhere
+	raw = !(flags & FLAG_DATA_DESCRIPTOR) && compSize > 0 && sink->beginCompressed(name, method, entryCrc, compSize, size);
+	if (raw)
+	{
+		writing = false;
+		state = ENTRY_DATA;
+		return true;
+	}
+
+	writing = sink->beginEntry(name, size);
+
+	if (method == METHOD_DEFLATED)
+	{
+		if (inflaterReady)
+			inflateReset(&inflater);
+		else if (inflateInit2(&inflater, -MAX_WBITS) == Z_OK)
+			inflaterReady = true;
+		else
+			return fail("couldn't initialize inflate");
+	}
+
+	state = ENTRY_DATA;
+
+	// directories and empty files have no data at all
+	if (compRemaining == 0)
+		return endEntry();
+
+	return true;
+}
+
+size_t ZipStream::feedEntryData(const char* data, size_t len)
+{
+	size_t avail = (size_t)std::min<uint64_t>(len, compRemaining);
+	bool streamed = flags & FLAG_DATA_DESCRIPTOR;
+
+	if (raw)
+	{
+		if (!sink->writeCompressed(data, avail))
+		{
+			fail("couldn't hand over entry data");
+			return avail;
+		}
+
+		compRemaining -= avail;
+		compRead += avail;
+
+		if (compRemaining == 0)
+			endEntry();
+
+		return avail;
+	}
+
+	// stored data goes straight through, and skipped entries with a known size don't need inflating
+	if (method == METHOD_STORED || (!writing && !streamed))
+	{
+		if (writing)
+		{
+			crc = StreamHash::updateCrc(crc, data, avail);
+			if (!sink->writeEntry(data, avail))
+			{
+				fail("couldn't write entry data");
+				return avail;
+			}
+		}
+
+		compRemaining -= avail;
+		compRead += avail;
+
+		if (compRemaining == 0)
+			endEntry();
+
+		return avail;
+	}
+
+	inflater.next_in = (Bytef*)data;
+	inflater.avail_in = avail;
+
+	int ret = Z_OK;
+	do
+	{
+		inflater.next_out = (Bytef*)chunk;
+		inflater.avail_out = ZIP_INFLATE_CHUNK;
+
+		ret = inflate(&inflater, Z_NO_FLUSH);
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+		{
+			fail("corrupt deflate data");
+			return avail;
+		}
+
+		size_t produced = ZIP_INFLATE_CHUNK - inflater.avail_out;
+		if (produced > 0 && writing)
+		{
+			crc = StreamHash::updateCrc(crc, chunk, produced);
+			if (!sink->writeEntry(chunk, produced))
+			{
+				fail("couldn't write entry data");
+				return avail;
+			}
+		}
+	} while (ret == Z_OK && (inflater.avail_in > 0 || inflater.avail_out == 0));
+
+	size_t used = avail - inflater.avail_in;
+	compRead += used;
+	if (!streamed)
+		compRemaining -= used;
+
+	if (ret == Z_STREAM_END)
+	{
+		if (streamed)
+			state = DATA_DESCRIPTOR;
+		else if (compRemaining != 0)
+			fail("entry is larger than its deflate stream");
+		else
+			endEntry();
+	}
+	else if (!streamed && compRemaining == 0)
+		fail("deflate stream is truncated");
+
+	return used;
+}
+
+size_t ZipStream::feedDescriptor(const char* data, size_t len)
+{
+	// [signature] crc compressed-size size, the sizes are 64-bit for zip64 entries
+	auto descriptorSize = [this]() -> size_t {
+		bool hasSignature = read32(pending.data()) == SIG_DATA_DESCRIPTOR;
+		return (hasSignature ? 4 : 0) + 4 + (compRead > 0xFFFFFFFF ? 16 : 8);
+	};
+
+	size_t needed = pending.size() >= 4 ? descriptorSize() : 4;
+	size_t take = std::min(len, needed - pending.size());
+	pending.append(data, take);
+
+	if (pending.size() < 4 || pending.size() < descriptorSize())
+		return take;
+
+	const char* p = pending.data();
+	if (read32(p) == SIG_DATA_DESCRIPTOR)
+		p += 4;
+
+	expectedCrc = read32(p);
+	pending.clear();
+	endEntry();
+
+	return take;
+}
+
+size_t ZipStream::feedSpill(const char* data, size_t len)
+{
+	if (fwrite(data, 1, len, spill) != len)
+		fail("couldn't write spill file");
+
+	return len;
+}
+
+bool ZipStream::endEntry()
+{
+	state = LOCAL_HEADER;
+
+	if (raw)
+	{
+		raw = false;
+		return sink->endCompressed() || fail("couldn't finish entry");
+	}
+
+	bool valid = !writing || crc == expectedCrc;
+
+	if (writing && !sink->endEntry(valid))
+		return fail("couldn't finish entry");
+
+	if (!valid)
+		return fail("crc mismatch");
+
+	return true;
+}
+
+bool ZipStream::finish()
+{
+	if (state == FAILED)
+		return false;
+
+	if (state == SPILLING)
+		return extractSpill();
+
+	if (state != TRAILER)
+		return fail("archive is truncated");
+
+	return true;
+}
+
+bool ZipStream::extractSpill()
+{
+	// reopen the spill to read back the central directory at its end
+	fclose(spill);
+	spill = fopen(spillPath.c_str(), "rb");
+	if (!spill)
+		return fail("couldn't reopen spill file");
+
+	uint16_t count;
+	uint32_t cdSize, cdOffset;
+	if (!readEndOfCentralDir(spill, &count, &cdSize, &cdOffset, nullptr))
+		return fail("archive has no central directory");
+
+	if (cdOffset < spillStart)
+		return fail("central directory is outside the spill");
+
+	std::vector<char> cd(cdSize);
+	fseek(spill, cdOffset - spillStart, SEEK_SET);
+	if (fread(cd.data(), 1, cdSize, spill) != cdSize)
+		return fail("couldn't read central directory");
+
+	std::vector<char> buffer(ZIP_INFLATE_CHUNK);
+
+	size_t pos = 0;
+	for (int i = 0; i < count && state != FAILED; i++)
+	{
+		if (pos + CENTRAL_DIR_SIZE > cd.size() || read32(&cd[pos]) != SIG_CENTRAL_DIR)
+			return fail("bad central directory entry");
+
+		const char* entry = &cd[pos];
+		uint16_t entryFlags = read16(entry + 8);
+		uint16_t entryMethod = read16(entry + 10);
+		uint32_t entryCrc = read32(entry + 16);
+		uint64_t compSize = read32(entry + 20);
+		uint64_t size = read32(entry + 24);
+		uint16_t nameLen = read16(entry + 28);
+		uint16_t extraLen = read16(entry + 30);
+		uint16_t commentLen = read16(entry + 32);
+		uint64_t localOffset = read32(entry + 42);
+		std::string name(entry + CENTRAL_DIR_SIZE, nameLen);
+
+		pos += CENTRAL_DIR_SIZE + nameLen + extraLen + commentLen;
+
+		// entries before the spill were already streamed
+		if (localOffset < spillStart)
+			continue;
+
+		if (compSize == 0xFFFFFFFF || size == 0xFFFFFFFF || localOffset == 0xFFFFFFFF)
+			return fail("zip64 entry " + name + " isn't supported");
+
+		char header[LOCAL_HEADER_SIZE];
+		fseek(spill, localOffset - spillStart, SEEK_SET);
+		if (fread(header, 1, LOCAL_HEADER_SIZE, spill) != LOCAL_HEADER_SIZE || read32(header) != SIG_LOCAL_HEADER)
+			return fail("bad local header for " + name);
+
+		fseek(spill, read16(header + 26) + read16(header + 28), SEEK_CUR);
+
+		// sizes are known now, so the data descriptor doesn't matter anymore
+		if (!startEntry(name, entryMethod, entryFlags & ~FLAG_DATA_DESCRIPTOR, entryCrc, compSize, size))
+			return false;
+
+		while (state == ENTRY_DATA)
+		{
+			size_t toRead = (size_t)std::min<uint64_t>(ZIP_INFLATE_CHUNK, compRemaining);
+			if (fread(buffer.data(), 1, toRead, spill) != toRead)
+				return fail("spill file is truncated");
+
+			size_t done = 0;
+			while (done < toRead && state == ENTRY_DATA)
+				done += feedEntryData(buffer.data() + done, toRead - done);
+		}
+	}
+
+	if (state == FAILED)
+		return false;
+
+	state = TRAILER;
+	return true;
+}
+
+bool ZipStream::verifyArchive(const std::string& path, std::string* error)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		*error = "couldn't open archive";
+		return false;
+	}
+
+	uint16_t count;
+	uint32_t cdSize, cdOffset;
+	long eocd;
+	bool valid = readEndOfCentralDir(file, &count, &cdSize, &cdOffset, &eocd);
+
+	// a complete archive ends with its central directory, right before the end record
+	if (!valid)
+		*error = "archive has no central directory";
+	else if ((uint64_t)cdOffset + cdSize != (uint64_t)eocd)
+	{
+		*error = "archive is truncated";
+		valid = false;
+	}
+
+	std::vector<char> cd(valid ? cdSize : 0);
+	if (valid)
+	{
+		fseek(file, cdOffset, SEEK_SET);
+		if (fread(cd.data(), 1, cdSize, file) != cdSize)
+		{
+			*error = "couldn't read central directory";
+			valid = false;
+		}
+	}
+
+	// every entry has to point at a local header inside the archive
+	size_t pos = 0;
+	for (int i = 0; valid && i < count; i++)
+	{
+		if (pos + CENTRAL_DIR_SIZE > cd.size() || read32(&cd[pos]) != SIG_CENTRAL_DIR)
+		{
+			*error = "bad central directory entry";
+			valid = false;
+			break;
+		}
+
+		uint32_t localOffset = read32(&cd[pos + 42]);
+		char header[4];
+		fseek(file, localOffset, SEEK_SET);
+		if (localOffset >= cdOffset || fread(header, 1, 4, file) != 4 || read32(header) != SIG_LOCAL_HEADER)
+		{
+			*error = "bad local header";
+			valid = false;
+			break;
+		}
+
+		pos += CENTRAL_DIR_SIZE + read16(&cd[pos + 28]) + read16(&cd[pos + 30]) + read16(&cd[pos + 32]);
+	}
+
+	fclose(file);
+	return valid;
+}
+
+bool ZipEntryInfo::streamable() const
+{
+	bool unknownLength = (flags & FLAG_DATA_DESCRIPTOR) && method == METHOD_STORED;
+	bool zip64 = compSize == 0xFFFFFFFF || size == 0xFFFFFFFF || localOffset == 0xFFFFFFFF;
+	return !unknownLength && !zip64 && !(flags & FLAG_ENCRYPTED);
+}
+
+bool ZipStream::findCentralDirectory(const std::string& tail, uint32_t* cdOffset, uint32_t* cdSize, size_t* eocd)
+{
+	for (long i = (long)tail.size() - END_OF_CENTRAL_DIR_SIZE; i >= 0; i--)
+	{
+		if (read32(&tail[i]) != SIG_END_OF_CENTRAL_DIR)
+			continue;
+
+		*cdSize = read32(&tail[i + 12]);
+		*cdOffset = read32(&tail[i + 16]);
+		*eocd = i;
+		return true;
+	}
+
+	return false;
+}
+
+bool ZipStream::parseCentralDirectory(const std::string& cd, std::vector<ZipEntryInfo>* entries)
+{
+	size_t pos = 0;
+	while (pos + CENTRAL_DIR_SIZE <= cd.size())
+	{
+		const char* entry = &cd[pos];
+		if (read32(entry) != SIG_CENTRAL_DIR)
+			return false;
+
+		uint16_t nameLen = read16(entry + 28);
+		uint16_t extraLen = read16(entry + 30);
+		uint16_t commentLen = read16(entry + 32);
+		if (pos + CENTRAL_DIR_SIZE + nameLen > cd.size())
+			return false;
+
+		ZipEntryInfo info;
+		info.name = std::string(entry + CENTRAL_DIR_SIZE, nameLen);
+		info.flags = read16(entry + 8);
+		info.method = read16(entry + 10);
+		info.crc = read32(entry + 16);
+		info.compSize = read32(entry + 20);
+		info.size = read32(entry + 24);
+		info.localOffset = read32(entry + 42);
+		entries->push_back(info);
+
+		pos += CENTRAL_DIR_SIZE + nameLen + extraLen + commentLen;
+	}
+
+	return pos == cd.size();
+}
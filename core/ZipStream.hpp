@@ -0,0 +1,141 @@
+#ifndef ZIPSTREAM_H_
+#define ZIPSTREAM_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+// size of the buffer entries are inflated into before being handed to the sink
+#define ZIP_INFLATE_CHUNK 0x10000
+
+// an entry as described by the central directory
+struct ZipEntryInfo
+{
+	std::string name;
+	uint16_t method;
+	uint16_t flags;
+	uint32_t crc;
+	uint64_t compSize;
+	uint64_t size;
+	uint64_t localOffset;
+
+	// whether feeding its local header and data to a ZipStream extracts it without the central directory
+	bool streamable() const;
+};
+
+// Receives the entries of an archive, in archive order, as they are inflated
+class ZipEntrySink
+{
+public:
+	virtual ~ZipEntrySink() { }
+
+	// a new entry (file or directory ending in /), return false to skip its data
+	virtual bool beginEntry(const std::string& name, uint64_t size) = 0;
+
+	// the next chunk of the current entry's inflated data
+	virtual bool writeEntry(const char* data, size_t len) = 0;
+
+	// the current entry is complete, valid is false if its crc didn't match
+	virtual bool endEntry(bool valid) = 0;
+
+	// offered before beginEntry for entries whose sizes are known up front, return true to
+	// receive the still compressed data instead (inflating and checking the crc is then up to the sink)
+	virtual bool beginCompressed(const std::string& name, uint16_t method, uint32_t crc, uint64_t compSize, uint64_t size) { return false; }
+	virtual bool writeCompressed(const char* data, size_t len) { return false; }
+	virtual bool endCompressed() { return false; }
+};
+
+// Incrementally parses and inflates a zip archive as it's fed bytes
+// (eg. straight from the network), without needing the whole file first.
+//
+// Entries that can't be streamed, because their sizes are only known from the
+// central directory at the end of the archive, make the rest of the archive
+// spill to a temp file, which is then extracted in finish().
+class ZipStream
+{
+public:
+	ZipStream(ZipEntrySink* sink, const std::string& spillPath);
+	~ZipStream();
+
+	// feed the next chunk of the archive, returns false if the archive can't be extracted
+	bool feed(const char* data, size_t len);
+
+	// called once the whole archive has been fed, extracts any spilled entries
+	bool finish();
+
+	// number of archive bytes fed so far (where a resumed transfer should pick up)
+	uint64_t consumed() const { return offset; }
+
+	// crc of the current entry's data so far (the whole entry's, once the sink's endEntry is called)
+	uint32_t entryCrc() const { return crc; }
+
+	// whether everything fed so far ended exactly on an entry boundary, for callers
+	// feeding individual entries (their local header onwards) instead of a whole archive
+	bool betweenEntries() const { return state == LOCAL_HEADER && pending.empty(); }
+
+	// locate the central directory from the end of an archive (its last 64k + 22 bytes or less),
+	// eocd is where the end record starts within tail
+	static bool findCentralDirectory(const std::string& tail, uint32_t* cdOffset, uint32_t* cdSize, size_t* eocd);
+	static bool parseCentralDirectory(const std::string& cd, std::vector<ZipEntryInfo>* entries);
+
+	// quick structural check of a downloaded archive (complete central directory,
+	// entries pointing at local headers), before anything is extracted from it
+	static bool verifyArchive(const std::string& path, std::string* error);
+
+	std::string error;
+
+private:
+	enum State
+	{
+		LOCAL_HEADER,
+		ENTRY_DATA,
+		DATA_DESCRIPTOR,
+		SPILLING,
+		TRAILER,
+		FAILED
+	};
+
+	bool fail(const std::string& reason);
+
+	size_t feedHeader(const char* data, size_t len);
+	size_t feedEntryData(const char* data, size_t len);
+	size_t feedDescriptor(const char* data, size_t len);
+	size_t feedSpill(const char* data, size_t len);
+
+	bool startEntry(const std::string& name, uint16_t method, uint16_t flags, uint32_t crc, uint64_t compSize, uint64_t size);
+	bool endEntry();
+	bool extractSpill();
+
+	ZipEntrySink* sink;
+	State state = LOCAL_HEADER;
+
+	// header/descriptor bytes buffered until they're complete
+	std::string pending;
+
+	// absolute offset into the archive
+	uint64_t offset = 0;
+
+	// the entry currently being inflated
+	uint16_t method = 0;
+	uint16_t flags = 0;
+	uint32_t expectedCrc = 0;
+	uint32_t crc = 0;
+	uint64_t compRemaining = 0;
+	uint64_t compRead = 0;
+	bool writing = false;
+	bool raw = false;
+
+	z_stream inflater;
+	bool inflaterReady = false;
+	char* chunk = nullptr;
+
+	// entries past this point are in the spill file
+	std::string spillPath;
+	FILE* spill = nullptr;
+	uint64_t spillStart = 0;
+};
+
+#endif
@@ -7,6 +7,9 @@
 #include "../libs/chesto/src/NetImageElement.hpp"
 #include "../libs/chesto/src/RootDisplay.hpp"
 
+#include "../core/ConnectionPool.hpp"
+#include "../core/OperationQueue.hpp"
+
 #include "rapidjson/document.h"
 
 #include "AboutScreen.hpp"
@@ -156,7 +159,7 @@ void AboutScreen::loadCreditsFromJSON()
 	std::string jsonContent;
 	std::string creditsUrl = std::string(META_REPO) + "/credits.json";
 	
-	bool success = downloadFileToMemory(creditsUrl, &jsonContent);
+	bool success = ConnectionPool::pool->fetch(creditsUrl, &jsonContent);
 	
 	if (success && !jsonContent.empty())
 	{
@@ -280,6 +283,7 @@ void AboutScreen::back()
 void AboutScreen::launchFeedback()
 {
 	// find the package corresponding to us
+	std::lock_guard<std::mutex> getGuard(OperationQueue::getLock);
 	for (auto& package : this->get->getPackages())
 	{
 		if (package->getPackageName() == APP_SHORTNAME)
@@ -1,5 +1,9 @@
+#include "../core/ConnectionPool.hpp"
+
 #include "AppCard.hpp"
 #include "AppList.hpp"
+#include "FramePacer.hpp"
+#include "FrameStats.hpp"
 #include "ThemeManager.hpp"
 #include "MainDisplay.hpp"
 
@@ -115,8 +119,13 @@ void AppCard::handleIconLoad()
 	if (CST_isRectOffscreen(&rect))
 		return;
 
+	// a downloading install gets the bandwidth, the card asks again every frame until it's done
+	if (ConnectionPool::pool && ConnectionPool::pool->installing())
+		return;
+
 	// the icon is either visible or ofscreen within 2 rows,
-	// so the download can be started
+	// so the download can be started (a cached one is loaded right away)
+	FrameStats::Timer timer(STAT_TEXTURE_UPLOAD);
 	icon.fetch();
 
 	// printf("Fetching icon for %s\n", package.getTitle().c_str());
@@ -126,15 +135,12 @@ void AppCard::handleIconLoad()
 
 void AppCard::render(Element* parent)
 {
+	FrameStats::Timer timer(STAT_APPCARD_RENDER);
+
 	this->xOff = parent->x;
 	this->yOff = parent->y;
 
-	// TODO: don't render this card if it's going to be offscreen anyway according to the parent (AppList)
-	CST_Rect rect = { this->xOff + this->x, this->yOff + this->y, this->width, this->height };
-	if (CST_isRectOffscreen(&rect))
-		return;
-
-	// render all the subelements of this card
+	// render all the subelements of this card (AppList only renders the ones on screen)
 	super::render(parent);
 }
 
@@ -154,6 +160,8 @@ void AppCard::displaySubscreen()
 
 bool AppCard::process(InputEvents* event)
 {
+	FrameStats::Timer timer(STAT_APPCARD_PROCESS);
+
 	if (list)
 	{
 		handleIconLoad();
@@ -162,7 +170,15 @@ bool AppCard::process(InputEvents* event)
 		this->yOff = this->list->y;
 	}
 
-	return super::process(event);
+	// the icon showing up changes the card, even without any input
+	bool changed = icon.loaded != iconShown;
+	iconShown = icon.loaded;
+
+	// so does the cursor's highlight, which animates as it's drawn
+	if (elasticCounter == THICK_HIGHLIGHT)
+		changed |= FramePacer::animate(&highlightStep);
+
+	return super::process(event) || changed;
 }
 
 AppCard::~AppCard()
@@ -25,6 +25,10 @@ public:
 	AppList* list;
 	bool iconFetch = false;
 
+	// whether the icon was loaded the last time the card was processed, and the highlight's last frame
+	bool iconShown = false;
+	uint32_t highlightStep = 0;
+
 	// the number of which package this is in the list
 	int index;
 
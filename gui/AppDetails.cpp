@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
@@ -14,14 +15,17 @@
 
 #include "../libs/chesto/src/RootDisplay.hpp"
 
+#include "../core/InstallJournal.hpp"
+#include "../core/InstalledDB.hpp"
+#include "../core/PackagePrefetch.hpp"
+#include "../core/OperationQueue.hpp"
+
 #include "AppDetails.hpp"
 #include "AppList.hpp"
 #include "Feedback.hpp"
 #include "ThemeManager.hpp"
 #include "main.hpp"
 
-int AppDetails::lastFrameTime = 99;
-
 AppDetails::AppDetails(Package& package, AppList* appList, AppCard* appCard)
 	: package(&package)
 	, get(appList->get)
@@ -33,6 +37,8 @@ AppDetails::AppDetails(Package& package, AppList* appList, AppCard* appCard)
 	, details(getPackageDetails(&package).c_str(), 20 / SCALER, &white, false, 300)
 	, content(&package, appList->useBannerIcons)
 	, downloadStatus(i18n("details.status"), 30 / SCALER, &white)
+	, verifyResult("", 24, &white, false, 300)
+	, conflictWarning("", 24, &red, false, 300)
 {
 	// TODO: show current app status somewhere
 
@@ -64,6 +70,7 @@ AppDetails::AppDetails(Package& package, AppList* appList, AppCard* appCard)
 
 		if (isTheme) // should only happen on switch
 		{
+			std::lock_guard<std::mutex> getGuard(OperationQueue::getLock);
 			auto installer = get->lookup("NXthemes_Installer");
 			injectorPresent = installer ? true : false; // whether or not the currently hardcoded installer package exists, in the future becomes something functionality-based like "theme_installer"
 			buttonLabel = (injectorPresent && installer->getStatus() == GET) ? i18n("details.injector") : i18n("details.inject");
@@ -81,6 +88,16 @@ AppDetails::AppDetails(Package& package, AppList* appList, AppCard* appCard)
 		}
 	}
 
+	// the files the last install replaced are still around, so going back is just a rename
+	if (package.getStatus() != GET && InstallJournal::hasPrevious(get, package.getPackageName()))
+	{
+		// every controller button on this screen is taken, so this one is touch only
+		previous = new Button(i18n("details.rollback"), 0, true, 20, download.width);
+		previous->position(SCREEN_WIDTH - 310, download.y - 70);
+		previous->action = std::bind(&AppDetails::rollback, this);
+		super::append(previous);
+	}
+
 	// more details
 
 	details.position(SCREEN_WIDTH - 340, 50);
@@ -89,6 +106,7 @@ AppDetails::AppDetails(Package& package, AppList* appList, AppCard* appCard)
 	// the scrollable portion of the app details page
 	content.moreByAuthor.action = std::bind(&AppDetails::moreByAuthor, this);
 	content.reportIssue.action = std::bind(&AppDetails::leaveFeedback, this);
+	content.verifyFiles.action = std::bind(&AppDetails::verify, this);
 	super::append(&content);
 
 	super::append(&download);
@@ -101,6 +119,9 @@ AppDetails::AppDetails(Package& package, AppList* appList, AppCard* appCard)
 
 	// download informations (not visible until the download is started)
 	downloadStatus.position(SCREEN_WIDTH / 2 - downloadProgress.width / 2, PANE_WIDTH / 2 - 70 / SCALER);
+
+	verifyResult.position(SCREEN_WIDTH - 310, SCREEN_HEIGHT - 330);
+	conflictWarning.position(SCREEN_WIDTH - 310, SCREEN_HEIGHT - 330);
 }
 
 AppDetails::~AppDetails()
@@ -110,6 +131,11 @@ AppDetails::~AppDetails()
 		super::remove(start);
 		delete start;
 	}
+	if (previous)
+	{
+		super::remove(previous);
+		delete previous;
+	}
 	if (errorText)
 	{
 		super::remove(errorText);
@@ -154,42 +180,193 @@ std::string AppDetails::getAction(Package* package)
 
 void AppDetails::proceed()
 {
-	if (this->operating) return;
-
-	this->operating = true;
-	// event->update();
-
-	// description of what we're doing
-	super::append(&downloadProgress);
-	super::append(&downloadStatus);
+	auto queue = OperationQueue::queue;
+	if (!queue) return;
 
-	// setup progress bar callback
-	networking_callback = AppDetails::updateCurrentlyDisplayedPopup;
-	libget_status_callback = AppDetails::updatePopupStatus;
+	// pressing it again while queued or running cancels the operation
+	if (this->operating)
+	{
+		queue->cancel(package->getPackageName());
+		return;
+	}
 
 	// if we're installing ourselves, we need to quit after on switch
 	preInstallHook();
 
-	// install or remove this package based on the package status
+	// install or remove this package based on the package status, in the background
 	if (this->package->getStatus() == INSTALLED)
-		get->remove(*package);
+		queue->enqueue(OP_REMOVE, *package);
 	else {
-		get->install(*package);
-		// save the icon to the SD card, for offline use
+		// the first press only warns if this would overwrite another package's files
+		if (!showingConflicts && showConflicts())
+			return;
+
+		// save the icon while we have it, it's moved to the SD card for offline use once installed
+		std::string iconSavePath;
 		if (appCard != NULL) {
-			auto iconSavePath = std::string(get->mPkg_path) + "/" + package->getPackageName() + "/icon.png";
+			iconSavePath = get->mTmp_path + package->getPackageName() + ".icon.png";
 			appCard->icon.saveTo(iconSavePath);
 			//TODO: load from a cache instead!!
 		}
+		queue->enqueue(OP_INSTALL, *package, iconSavePath, quitAfterInstall);
 	}
 
-	postInstallHook();
+	updateOperation();
+}
 
-	// refresh the screen
-	RootDisplay::switchSubscreen(nullptr);
+bool AppDetails::showConflicts()
+{
+	if (!InstalledDB::db)
+		return false;
+
+	// the same manifest the installer will follow, G files are only written when missing so they never conflict
+	std::vector<std::string> paths;
+	std::istringstream lines(content.remoteManifest(package));
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.size() > 3 && line[1] == ':' && line[0] != 'G')
+			paths.push_back(line.substr(3));
+	}
+
+	std::vector<std::string> owners;
+	for (auto& conflict : InstalledDB::db->conflicts(package->getPackageName(), paths))
+	{
+		printf("--> %s overwrites %s, which %s installed\n", package->getPackageName().c_str(), conflict.first.c_str(), conflict.second.c_str());
+		if (std::find(owners.begin(), owners.end(), conflict.second) == owners.end())
+			owners.push_back(conflict.second);
+	}
+
+	if (owners.empty())
+		return false;
+
+	std::string names;
+	for (auto& owner : owners)
+		names += (names.empty() ? "" : ", ") + owner;
+
+	if (showingVerifyResult)
+		super::remove(&verifyResult);
+	showingVerifyResult = false;
+
+	conflictWarning.setText(replaceAll(i18n("details.conflicts"), "NAME", names));
+	conflictWarning.update();
+	super::append(&conflictWarning);
+	showingConflicts = true;
+	return true;
+}
+
+void AppDetails::verify()
+{
+	auto queue = OperationQueue::queue;
+	if (!queue || this->operating) return;
+
+	// drop the result of an earlier verify that nobody was around to see
+	Operation stale(OP_VERIFY, *package);
+	queue->takeVerified(package->getPackageName(), &stale);
+
+	this->verifying = true;
+	queue->enqueue(OP_VERIFY, *package);
+	updateOperation();
+}
+
+void AppDetails::rollback()
+{
+	auto queue = OperationQueue::queue;
+	if (!queue || this->operating) return;
+
+	queue->enqueue(OP_ROLLBACK, *package);
+	updateOperation();
+}
+
+void AppDetails::showVerifyResult(const Operation& result)
+{
+	super::remove(&downloadProgress);
+	super::remove(&downloadStatus);
+	download.updateText(getAction(package).c_str());
+
+	for (auto& path : result.damaged)
+		printf("--> %s is missing or damaged\n", path.c_str());
+
+	std::string text = i18n("details.verify.none");
+	if (result.checked >= 0 && result.damaged.empty())
+		text = replaceAll(i18n("details.verify.ok"), "COUNT", std::to_string(result.checked));
+	else if (result.checked >= 0)
+		text = replaceAll(i18n("details.verify.damaged"), "COUNT", std::to_string(result.damaged.size()));
+
+	verifyResult.setText(text);
+	verifyResult.update();
+
+	if (!showingVerifyResult)
+		super::append(&verifyResult);
+	showingVerifyResult = true;
+}
+
+void AppDetails::updateOperation()
+{
+	auto queue = OperationQueue::queue;
+	int id = queue ? queue->find(package->getPackageName()) : -1;
+	bool queued = id >= 0;
+
+	if (queued != this->operating)
+	{
+		Operation result(OP_VERIFY, *package);
+		if (!queued && this->verifying && queue->takeVerified(package->getPackageName(), &result))
+		{
+			// nothing changed on disk, so stay on this screen to show what was found
+			this->operating = false;
+			this->verifying = false;
+			showVerifyResult(result);
+			return;
+		}
+
+		if (!queued)
+		{
+			// finished or cancelled, the package statuses changed so go back to the list
+			RootDisplay::switchSubscreen(nullptr);
+			this->operating = false;
+			return;
+		}
+
+		if (showingVerifyResult)
+			super::remove(&verifyResult);
+		showingVerifyResult = false;
+		if (showingConflicts)
+			super::remove(&conflictWarning);
+
+		// description of what we're doing
+		this->operating = true;
+		super::append(&downloadProgress);
+		super::append(&downloadStatus);
+		download.updateText(i18n("details.abort").c_str());
+	}
 
-	this->operating = false;
-	this->appList->update();
+	if (!queued) return;
+
+	// the queue publishes progress without locking, so this is cheap to read every frame
+	auto& progress = queue->progress;
+	std::string status;
+
+	if (queue->isRunning(id))
+	{
+		int64_t total = progress.bytesTotal;
+		downloadProgress.percent = total > 0 ? (double)progress.bytesNow / total : 0;
+		status = statusText(progress.stage, package->getTitle(), progress.item, progress.itemTotal);
+	}
+	else
+	{
+		downloadProgress.percent = 0;
+		status = i18n("details.queued");
+	}
+
+	// only re-render the text when it actually changed
+	if (status != lastStatus)
+	{
+		lastStatus = status;
+		downloadStatus.setText(status);
+		downloadStatus.update();
+	}
 }
 
 void AppDetails::launch()
@@ -206,7 +383,10 @@ void AppDetails::launch()
 
 	if (package->getCategory() == "theme")
 	{
+		std::unique_lock<std::mutex> getGuard(OperationQueue::getLock);
 		auto installer = get->lookup("NXthemes_Installer"); // This should probably be more dynamic in future, e.g. std::vector<Package*> Get::find_functionality("theme_installer")
+		getGuard.unlock();
+
 		if (installer && installer->getStatus() != GET)
 		{
 			snprintf(path, sizeof(path), ROOT_PATH "%s", installer->getBinary().c_str()+1);
@@ -244,15 +424,17 @@ void AppDetails::launch()
 
 void AppDetails::getSupported()
 {
+	std::unique_lock<std::mutex> getGuard(OperationQueue::getLock);
 	auto installer = get->lookup("NXthemes_Installer");
+	getGuard.unlock();
+
 	if (installer)
 		RootDisplay::switchSubscreen(new AppDetails(installer.value(), appList));
 }
 
 void AppDetails::back()
 {
-	if (this->operating) return;
-
+	// anything queued keeps going in the background
 	RootDisplay::switchSubscreen(nullptr);
 }
 
@@ -277,7 +459,15 @@ bool AppDetails::process(InputEvents* event)
 	if (event->isTouchDown())
 		this->dragging = true;
 
-	if (this->operating) return false;
+	updateOperation();
+
+	// staying on a package that can be downloaded is a good sign it's about to be
+	if (!prefetchRequested && PackagePrefetch::prefetch && !operating && CST_GetTicks() - openedAt > PREFETCH_DWELL_MS)
+	{
+		prefetchRequested = true;
+		if (package->getStatus() == GET || package->getStatus() == UPDATE)
+			PackagePrefetch::prefetch->request(*package);
+	}
 
 	if (content.showingScreenshot)
 	{
@@ -285,7 +475,9 @@ bool AppDetails::process(InputEvents* event)
 		// TODO: this is a pattern chesto should handle better (like a stack of subscreens)
 		return elements[elements.size() - 1]->process(event);
 	}
-	return super::process(event);
+
+	// keep redrawing while the progress bar moves
+	return super::process(event) || this->operating;
 }
 
 void AppDetails::preInstallHook()
@@ -306,32 +498,25 @@ void AppDetails::preInstallHook()
 
 bool AppDetails::themeInstall(char* installerPath)
 {
-	std::string ManifestPathInternal = "manifest.install";
-	std::string ManifestPath = get->mPkg_path + this->package->getPackageName() + "/" + ManifestPathInternal;
-
 	std::vector<std::string> themePaths;
 
-	if (!package->manifest.isValid()) {
-		package->manifest = Manifest(ManifestPath, ROOT_PATH);
+	// the installed db already has the manifest, no need to parse it again
+	InstalledPackage installed;
+	if (!InstalledDB::db || !InstalledDB::db->find(package->getPackageName(), &installed) || installed.files.empty())
+	{
+		printf("--> ERROR: no manifest found for %s\n", package->getPackageName().c_str());
+		return false;
 	}
 
-	if (package->manifest.isValid())
+	std::string extension = ".nxtheme";
+	for (auto& file : installed.files)
 	{
-		auto entries = package->manifest.getEntries();
-		for (size_t i = 0; i <= entries.size() - 1; i++)
+		if (file.op == 'U' && file.path.size() > extension.size() && file.path.compare(file.path.size() - extension.size(), extension.size(), extension) == 0)
 		{
-			if (entries[i].operation == MUPDATE && entries[i].extension == "nxtheme")
-			{
-				printf("Found nxtheme\n");
-				themePaths.push_back(entries[i].path);
-			}
+			printf("Found nxtheme\n");
+			themePaths.push_back(ROOT_PATH + file.path);
 		}
 	}
-	else
-	{
-		printf("--> ERROR: no manifest found/manifest invalid at %s\n", ManifestPath.c_str());
-		return false;
-	}
 
 	std::string themeArg = "installtheme=";
 	for (int i = 0; i < (int)themePaths.size(); i++)
@@ -380,16 +565,6 @@ bool AppDetails::launchFile(char* path, char* context)
 	return false;
 }
 
-void AppDetails::postInstallHook()
-{
-	networking_callback = nullptr;
-	libget_status_callback = nullptr;
-
-	if (quitAfterInstall) {
-		RootDisplay::mainDisplay->requestQuit();
-	}
-}
-
 void AppDetails::render(Element* parent)
 {
 	if (this->parent == NULL)
@@ -407,78 +582,33 @@ void AppDetails::render(Element* parent)
 	super::render(parent);
 }
 
-int AppDetails::updatePopupStatus(int status, int num, int num_total)
+std::string AppDetails::statusText(int status, const std::string& title, int num, int num_total)
 {
-	auto screen = RootDisplay::subscreen;
 	std::stringstream statusText;
 
-	if (screen != NULL)
-	{
-		AppDetails* popup = (AppDetails*)screen;
-		Package* package = popup->package;
-
-		if (status < 0 || status >= 5) return 0;
-		std::string statuses[6] = {
-			i18n("details.download.verb") + " ",
-			i18n("details.install.verb") + " ",
-			i18n("details.remove.verb") + " ",
-			i18n("details.reloading"),
-			i18n("details.syncing") + " ",
-			i18n("details.analyzing") + " "
-		};
-
-		statusText << statuses[status];
-
-		if (status <= STATUS_REMOVING)
-			statusText << package->getTitle();
-
-		statusText << "...";
+	if (status < 0 || status > STATUS_ANALYZING) return "";
+	std::string statuses[6] = {
+		i18n("details.download.verb") + " ",
+		i18n("details.install.verb") + " ",
+		i18n("details.remove.verb") + " ",
+		i18n("details.reloading"),
+		i18n("details.syncing") + " ",
+		i18n("details.analyzing") + " "
+	};
 
-		if (num_total != 1)
-		{
-			// num_total for this operation isn't 1, so let's display a counter in parens
-			// (for instance, with multiple repos)
-			statusText << " (" << num << "/" << num_total << ")";
-		}
-
-		popup->downloadStatus.setText(statusText.str());
-		popup->downloadStatus.update();
-	}
-	return 0;
-}
-
-int AppDetails::updateCurrentlyDisplayedPopup(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow)
-{
-	int now = CST_GetTicks();
-	int diff = now - AppDetails::lastFrameTime;
+	statusText << statuses[status];
 
-	if (dltotal == 0) dltotal = 1;
+	if (status <= STATUS_REMOVING)
+		statusText << title;
 
-	double amount = dlnow / dltotal;
+	statusText << "...";
 
-	// don't update the GUI too frequently here, it slows down downloading
-	// (never return early if it's 100% done)
-	if (diff < 32 && amount != 1)
-		return 0;
-
-	AppDetails* popup = (AppDetails*)RootDisplay::subscreen;
-
-	// update the amount
-	if (popup != NULL)
+	if (num_total != 1)
 	{
-		popup->downloadProgress.percent = amount;
-
-		// force render the element right here (and it's progress bar too)
-		if (popup->parent != NULL)
-		{
-			InputEvents* events = new InputEvents();
-			while (events->update())
-				RootDisplay::mainDisplay->process(events);
-			RootDisplay::mainDisplay->render(NULL);
-		}
+		// num_total for this operation isn't 1, so let's display a counter in parens
+		// (for instance, with multiple repos)
+		statusText << " (" << num << "/" << num_total << ")";
 	}
 
-	AppDetails::lastFrameTime = CST_GetTicks();
-
-	return 0;
+	return statusText.str();
 }
@@ -4,6 +4,8 @@
 #include "AppDetailsContent.hpp"
 #include "AppCard.hpp"
 
+#include "../core/OperationQueue.hpp"
+
 class AppList;
 
 class AppDetails : public Element
@@ -35,20 +37,22 @@ public:
 
 	bool canLaunch = false;
 
-	// the callback method to update the currently displayed pop up (and variables it needs)
-	static int updateCurrentlyDisplayedPopup(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow);
-	static int updatePopupStatus(int status, int num = 1, int num_total = 1);
-	static int lastFrameTime;
+	// the text describing a libget status (downloading, installing...) for a package
+	static std::string statusText(int status, const std::string& title, int num = 1, int num_total = 1);
+
+	// sync the popup with this package's operation in the background queue
+	void updateOperation();
 
 	void proceed();
 	void back();
 	void launch();
+	void verify();
+	void rollback();
 
 	void moreByAuthor();
 	void leaveFeedback();
 
 	void preInstallHook();
-	void postInstallHook();
 
 	ProgressBar downloadProgress;
 
@@ -57,10 +61,27 @@ public:
 
 private:
 	Button* start = nullptr;
+	Button* previous = nullptr;
 	TextElement* errorText = nullptr;
 	TextElement details;
 	AppDetailsContent content;
 	TextElement downloadStatus;
+	std::string lastStatus;
+
+	// when the page opened, its package is prefetched after it's been up for a while
+	int openedAt = CST_GetTicks();
+	bool prefetchRequested = false;
+
+	// a verify reports back on this screen, instead of returning to the list
+	bool verifying = false;
+	void showVerifyResult(const Operation& result);
+	TextElement verifyResult;
+	bool showingVerifyResult = false;
+
+	// an install that overwrites other packages' files needs a second press
+	bool showConflicts();
+	TextElement conflictWarning;
+	bool showingConflicts = false;
 
 	Button download;
 	Button cancel;
@@ -10,8 +10,12 @@
 
 #include "../libs/chesto/src/RootDisplay.hpp"
 
+#include "../core/ConnectionPool.hpp"
+#include "../core/InstalledDB.hpp"
+
 #include "AppDetailsContent.hpp"
 #include "Feedback.hpp"
+#include "FrameStats.hpp"
 #include "AppList.hpp"
 #include "ThemeManager.hpp"
 #include "main.hpp"
@@ -37,7 +41,8 @@ std::string getTrimmedDetails(AppDetailsContent* content, std::string details)
   } else {
 	// already expanded, so don't show the "read more" button
 	// (or consider it already expanded, if ya will)
-	content->expandedReadMore = true;
+	if (content)
+		content->expandedReadMore = true;
   }
 
   return trimmedDetails;
@@ -46,6 +51,7 @@ std::string getTrimmedDetails(AppDetailsContent* content, std::string details)
 AppDetailsContent::AppDetailsContent(Package *package, bool useBannerIcons)
 	: reportIssue(i18n("contents.report"), L_BUTTON)
 	, moreByAuthor(i18n("contents.more"), R_BUTTON)
+	, verifyFiles(i18n("contents.verify"), SELECT_BUTTON)
 	, title(package->getTitle().c_str(), 35, &HBAS::ThemeManager::textPrimary)
 	, title2(package->getAuthor().c_str(), 27, &HBAS::ThemeManager::textSecondary)
 	, details(i18n("contents.placeholder1"), 20 / SCALER, &HBAS::ThemeManager::textPrimary, false, PANE_WIDTH + 20 / SCALER)
@@ -77,9 +83,16 @@ AppDetailsContent::AppDetailsContent(Package *package, bool useBannerIcons)
 
 	if (package->getStatus() != GET) {
 		reportIssue.position(marginOffset - reportIssue.width, 45);
+		marginOffset = reportIssue.x - 20;
 		super::append(&reportIssue);
 	}
 
+	// only installs from the store have files to check against
+	if (package->getStatus() == INSTALLED || package->getStatus() == UPDATE) {
+		verifyFiles.position(marginOffset - verifyFiles.width, 45);
+		super::append(&verifyFiles);
+	}
+
 	banner.setScaleMode(SCALE_PROPORTIONAL_WITH_BG);
 	banner.resize(848 / SCALER, 208 / SCALER);	// banners use icon height now
 	banner.position(BANNER_X / SCALER - 26, BANNER_Y);
@@ -192,6 +205,8 @@ void AppDetailsContent::slideUIDown(int heightDiff) {
 
 void AppDetailsContent::render(Element* parent)
 {
+	FrameStats::Timer timer(STAT_DETAILS_RENDER);
+
 	if (this->parent == NULL)
 		this->parent = parent;
 	
@@ -214,6 +229,7 @@ void AppDetailsContent::render(Element* parent)
 
 bool AppDetailsContent::process(InputEvents* event)
 {
+	FrameStats::Timer timer(STAT_DETAILS_PROCESS);
 	bool ret = false;
 	if (showingScreenshot) {
 		// ignore all input events while showing a screenshot
@@ -289,9 +305,44 @@ bool AppDetailsContent::process(InputEvents* event)
 		this->y = -maxScrollOffset;
 	}
 
+	// the banner or a screenshot showing up changes the page, even without any input
+	int loaded = banner.loaded;
+	for (auto image : screenshotsContainer.elements)
+		loaded += ((NetImageElement*)image)->loaded;
+	if (loaded != imagesShown)
+		ret = true;
+	imagesShown = loaded;
+
 	return ret;
 }
 
+// " (also installed by X)" when packages other than this one put a file at path
+static std::string ownedBy(Package* package, const std::string& path)
+{
+	if (!InstalledDB::db)
+		return "";
+
+	std::string others;
+	for (auto& owner : InstalledDB::db->owners(path)) {
+		if (owner != package->getPackageName())
+			others += (others.empty() ? "" : ", ") + owner;
+	}
+
+	return others.empty() ? "" : " " + replaceAll(i18n("contents.files.owner"), "NAME", others);
+}
+
+const std::string& AppDetailsContent::remoteManifest(Package* package)
+{
+	// a failed fetch is tried again the next time it's asked for
+	if (!manifestFetched)
+	{
+		manifest.clear();
+		manifestFetched = ConnectionPool::pool->fetch(package->getManifestUrl(), &manifest);
+	}
+
+	return manifest;
+}
+
 void AppDetailsContent::switchExtraInfo(Package* package, int newState) {
 
 	// update button text
@@ -315,22 +366,34 @@ void AppDetailsContent::switchExtraInfo(Package* package, int newState) {
 	{
 		std::stringstream allEntries;
 
-		// if it's an installed package, use the already installed manifest
+		// if it's an installed package, use what the installed db recorded for it
 		// (LOCAL -> UPDATE packages won't have a manifest)
 		auto status = package->getStatus();
-		if ((status == INSTALLED || status == UPDATE) && package->manifest .isValid()) {
+		InstalledPackage installed;
+		if ((status == INSTALLED || status == UPDATE) && InstalledDB::db && InstalledDB::db->find(package->getPackageName(), &installed) && !installed.files.empty()) {
 			allEntries << i18n("contents.files.current") + "\n";
-			for (auto &entry : package->manifest.getEntries()) {
-				allEntries << entry.raw << "\n";
+			for (auto &file : installed.files) {
+				allEntries << file.op << ": " << file.path << ownedBy(package, file.path) << "\n";
 			}
 			allEntries << "\n";
 		}
 
 		if (status != INSTALLED) {
 			// manifest is either non-local, or we need to display both, download it from the server
-			std::string data("");
-			downloadFileToMemory(package->getManifestUrl().c_str(), &data);
-			allEntries << i18n("contents.files.remote") + "\n" << data;
+			const std::string& data = remoteManifest(package);
+			allEntries << i18n("contents.files.remote") + "\n";
+
+			// files another installed package already put there get overwritten by this install
+			std::istringstream lines(data);
+			std::string line;
+			while (std::getline(lines, line)) {
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				allEntries << line;
+				if (line.size() > 3 && line[1] == ':' && line[0] != 'G')
+					allEntries << ownedBy(package, line.substr(3));
+				allEntries << "\n";
+			}
 		}
 
 		changelog.setText(std::string("") + allEntries.str().c_str());
@@ -15,6 +15,11 @@
 #define SHOW_CHANGELOG 1
 #define SHOW_LIST_OF_FILES 2
 
+class AppDetailsContent;
+
+// the description as the page first shows it (content can be null when it's not for a page)
+std::string getTrimmedDetails(AppDetailsContent* content, std::string details);
+
 class AppDetailsContent : public ListElement
 {
 public:
@@ -24,8 +29,12 @@ public:
 	void switchExtraInfo(Package* package, int newState);
 	void slideUIDown(int heightOffset);
 
+	// the package's remote manifest.install, fetched the first time it's needed
+	const std::string& remoteManifest(Package* package);
+
 	Button reportIssue;
 	Button moreByAuthor;
+	Button verifyFiles;
 
 	CST_Color gray = { 0x50, 0x50, 0x50, 0xff };
 	CST_Color black = { 0x00, 0x00, 0x00, 0xff };
@@ -52,5 +61,11 @@ private:
 
 	int extraContentState = SHOW_NEITHER;
 	int curScreenIdx = 0;
+
+	std::string manifest;
+	bool manifestFetched = false;
+
+	// how many of the banner and screenshots had loaded the last time the page was processed
+	int imagesShown = 0;
 };
 #endif
\ No newline at end of file
@@ -1,11 +1,15 @@
 #include "MainDisplay.hpp"
 #include "AboutScreen.hpp"
+#include "BackgroundJobs.hpp"
 #include "FeedbackCenter.hpp"
+#include "FrameStats.hpp"
 #include "ThemeManager.hpp"
 #include "main.hpp"
 
 #include "../libs/get/src/Utils.hpp"
 
+#include "../core/OperationQueue.hpp"
+
 #include "../libs/chesto/src/EKeyboard.hpp"
 #include "../libs/chesto/src/RootDisplay.hpp"
 #include "../libs/chesto/src/Constraint.hpp"
@@ -36,6 +40,7 @@ AppList::AppList(Get* get, Sidebar* sidebar)
 	, quitBtn(i18n("listing.quit"), SELECT_BUTTON, false, 15)
 	, creditsBtn(i18n("listing.credits"), START_BUTTON, false, 15)
 	, sortBtn(i18n("listing.adjustsort"), Y_BUTTON, false, 15)
+	, updateAllBtn(i18n("listing.updateall"), R_BUTTON, false, 15)
 	, keyboardBtn(i18n("listing.togglekeyboard"), Y_BUTTON, false, 15)
 	, backspaceBtn(i18n("listing.delete"), B_BUTTON, false, 15)
 	, nowPlayingText(" ", 20, &HBAS::ThemeManager::textPrimary)
@@ -63,6 +68,7 @@ AppList::AppList(Get* get, Sidebar* sidebar)
 	// additional buttons
 	creditsBtn.action = std::bind(&AppList::launchSettings, this, false);
 	sortBtn.action = std::bind(&AppList::cycleSort, this);
+	updateAllBtn.action = std::bind(&AppList::updateAll, this);
 	
 #if defined(MUSIC)
 	muteBtn.action = std::bind(&AppList::toggleAudio, this);
@@ -125,6 +131,7 @@ AppList::AppList(Get* get, Sidebar* sidebar)
 
 bool AppList::process(InputEvents* event)
 {
+	FrameStats::Timer timer(STAT_APPLIST_PROCESS);
 	bool ret = false;
 
 	// R is the number of cards per row, let's figure it out based on app card size
@@ -138,6 +145,12 @@ bool AppList::process(InputEvents* event)
 		this->x = 400/SCALER - 260/SCALER * hideSidebar;
 		sidebar->width = this->x - 35/SCALER; // width of the sidebar is space between edge and applist
 		sidebar->addHints();
+
+		// the cards move to the new columns now, the cached rows were drawn for the old ones
+		for (auto& card : appCards)
+			placeCard(card);
+		cardRows.clear();
+
 		update();
 		return true;
 	}
@@ -145,9 +158,8 @@ bool AppList::process(InputEvents* event)
 	// must be done before keyboard stuff to properly switch modes
 	if (event->isTouchDown())
 	{
-		// remove a highlight if it exists (TODO: same as an above if statement)
-		if (this->highlighted >= 0 && this->highlighted < this->elements.size() && this->elements[this->highlighted])
-			this->elements[this->highlighted]->elasticCounter = NO_HIGHLIGHT;
+		// remove a highlight if it exists
+		reorient();
 
 		// got a touch, so let's enter touchmode
 		this->highlighted = -1;
@@ -166,7 +178,11 @@ bool AppList::process(InputEvents* event)
 		if (event->isKeyDown() && (event->held(Y_BUTTON) || event->held(B_BUTTON)))
 			ret |= ListElement::process(event); // continue processing ONLY if they're pressing Y or B
 		else if (event->noop)
-			ret |= ListElement::process(event); // continue processing if they're not pressing anything
+		{
+			// continue processing if they're not pressing anything
+			ret |= processScroll(event);
+			ret |= processCards(event);
+		}
 		
     if (needsUpdate) update();
     return ret;
@@ -202,9 +218,9 @@ bool AppList::process(InputEvents* event)
 				ret |= true;
 			}
 
-			if (event->held(A_BUTTON) && this->highlighted >= 0)
+			if (event->held(A_BUTTON) && this->highlighted >= 0 && this->highlighted < totalCount)
 			{
-				this->elements[this->highlighted]->action();
+				appCards[this->highlighted].action();
 				ret |= true;
 			}
 
@@ -214,8 +230,7 @@ bool AppList::process(InputEvents* event)
 
 			// look up whatever is currently chosen as the highlighted position
 			// and remove its highlight
-			if (this->elements[this->highlighted])
-				this->elements[this->highlighted]->elasticCounter = NO_HIGHLIGHT;
+			reorient();
 
 			// if we got a LEFT key while on the left most edge already, transfer to categories
 			if (this->highlighted % R == 0 && event->held(LEFT_BUTTON))
@@ -236,55 +251,41 @@ bool AppList::process(InputEvents* event)
 			this->highlighted += -1 * R * (event->held(UP_BUTTON)) + R * (event->held(DOWN_BUTTON));
 
 			// don't let the cursor go out of bounds
-			if (this->highlighted >= (int)this->elements.size()) this->highlighted = this->elements.size() - 1;
-
 			if (this->highlighted < 0) this->highlighted = 0;
 			if (this->highlighted >= (int)this->totalCount) this->highlighted = this->totalCount - 1;
 
 			if (currentSelected != this->highlighted) {
 				// we moved the cursor, so play a sound
 				mainDisplay->playSFX();
+				travel = this->highlighted - currentSelected;
 			}
 		}
 	}
 
 	// always check the currently highlighted piece and try to give it a thick border or adjust the screen
-	if (!touchMode && this->elements.size() > this->highlighted && this->highlighted >= 0 && this->elements[this->highlighted])
+	if (!touchMode && this->highlighted >= 0 && this->highlighted < totalCount)
 	{
 		// if our highlighted position is large enough, force scroll the screen so that our cursor stays on screen
-		Element* curTile = this->elements[this->highlighted];
+		Element* curTile = &appCards[this->highlighted];
 
 		// the y-position of the currently highlighted tile, precisely on them screen (accounting for scroll)
 		// this means that if it's < 0 or > SCREEN_HEIGHT then it's not visible
 		int normalizedY = curTile->y + this->y;
 
-		// if we're FAR out of range upwards, speed up the scroll wheel (additive) to get back in range quicker
-		if (normalizedY < -200)
-			event->wheelScroll += 0.3;
-
-		// far out of range, for bottom of screen
-		else if (normalizedY > SCREEN_HEIGHT - curTile->height + 200)
-			event->wheelScroll -= 0.3;
-
-		// if we're slightly out of range above, recenter at the top row slowly
-		else if (normalizedY < -100)
-			event->wheelScroll = 1;
-
-		// special case, scroll when we're on the bottom row of the top of the not-yet-scrolled screen
-		else if (this->y == 0 && normalizedY > SCREEN_HEIGHT/2)
-			event->wheelScroll -= 0.5;
-
-		// if we're out of range below, recenter at bottom row
-		else if (normalizedY > SCREEN_HEIGHT - curTile->height + 100)
-			event->wheelScroll = -1;
-
-		// if the card is this close to the top, just set it the list offset to 0 to scroll up to the top
-		else if (this->y != 0 && this->highlighted < R)
-			event->wheelScroll = 1;
+		// when the cursor moves, glide so its row is on screen (the top row shows the header too)
+		if (origHighlight != this->highlighted)
+		{
+			if (this->highlighted < R)
+				scroll.scrollTo(0);
+			else if (normalizedY < SCROLL_EDGE)
+				scroll.scrollTo(SCROLL_EDGE - curTile->y);
+			else if (normalizedY > SCREEN_HEIGHT - curTile->height - SCROLL_EDGE)
+				scroll.scrollTo(SCREEN_HEIGHT - curTile->height - SCROLL_EDGE - curTile->y);
+		}
 
-		if (this->elements[this->highlighted] && this->elements[this->highlighted]->elasticCounter == NO_HIGHLIGHT)
+		if (curTile->elasticCounter == NO_HIGHLIGHT)
 		{
-			this->elements[this->highlighted]->elasticCounter = THICK_HIGHLIGHT;
+			curTile->elasticCounter = THICK_HIGHLIGHT;
 			ret |= true;
 		}
 	}
@@ -293,7 +294,24 @@ bool AppList::process(InputEvents* event)
 	if (origHighlight != this->highlighted)
 		ret |= true;
 
-	ret |= ListElement::process(event);
+	// warm up the details page of the card the cursor rests on, and the ones it's heading towards
+	if (!touchMode && this->highlighted >= 0 && this->highlighted < totalCount)
+	{
+		std::vector<Package*> ahead;
+		for (int x = 1; x <= HOVER_LOOKAHEAD; x++)
+		{
+			int next = this->highlighted + travel * x;
+			if (next >= 0 && next < totalCount)
+				ahead.push_back(appCards[next].package);
+		}
+		hover.update(appCards[this->highlighted].package, ahead, useBannerIcons);
+	}
+
+	ret |= processScroll(event);
+	ret |= processCards(event);
+
+	// a glide can go a tick without moving a whole pixel, it still needs the next one
+	ret |= scroll.moving();
 
 	if (needsUpdate)
 		update();
@@ -303,6 +321,8 @@ bool AppList::process(InputEvents* event)
 
 void AppList::render(Element* parent)
 {
+	FrameStats::Timer timer(STAT_APPLIST_RENDER);
+
 	if (this->parent == NULL)
 		this->parent = parent;
 
@@ -315,10 +335,124 @@ void AppList::render(Element* parent)
     CST_FillRect(RootDisplay::renderer, &dimens);
   }
 
+	// only the rows on screen, under the buttons and keyboard
+	int first, last;
+	visibleCards(&first, &last);
+	cardRows.render(this, appCards, R, first, last);
+
 	super::render(parent);
 }
 
-bool AppList::sortCompare(const Package& left, const Package& right)
+void AppList::visibleCards(int* first, int* last, int rowsAhead)
+{
+	*first = *last = 0;
+	if (appCards.empty())
+		return;
+
+	// every card is the same size, so rows can be found from the scroll offset alone
+	int rowHeight = appCards.front().height + CARD_GAP_Y;
+	int top = -this->y - CARDS_TOP;
+
+	int firstRow = std::max(top, 0) / rowHeight - rowsAhead;
+	int lastRow = std::max(top + SCREEN_HEIGHT, 0) / rowHeight + rowsAhead;
+
+	*first = std::min(std::max(firstRow, 0) * R, totalCount);
+	*last = std::min((lastRow + 1) * R, totalCount);
+}
+
+int AppList::cardAt(int x, int y)
+{
+	if (appCards.empty())
+		return -1;
+
+	AppCard& card = appCards.front();
+	int columnWidth = card.width + CARD_GAP_X;
+	int rowHeight = card.height + CARD_GAP_Y;
+
+	int gridX = x - this->x - CARDS_LEFT;
+	int gridY = y - this->y - CARDS_TOP;
+	if (gridX < 0 || gridY < 0 || gridX / columnWidth >= R)
+		return -1;
+
+	// in the gap between two cards
+	if (gridX % columnWidth >= card.width || gridY % rowHeight >= card.height)
+		return -1;
+
+	int index = (gridY / rowHeight) * R + gridX / columnWidth;
+	return index < totalCount ? index : -1;
+}
+
+bool AppList::processScroll(InputEvents* event)
+{
+	// something else moved the list (a new category or search), the scroll carries on from there
+	if (this->y != scrolledTo)
+		scroll.jump(this->y);
+
+	if (!appCards.empty())
+	{
+		int rowHeight = appCards.front().height + CARD_GAP_Y;
+		int rows = (totalCount + R - 1) / R;
+		scroll.setRows(rowHeight, SCREEN_HEIGHT - CARDS_TOP - rows * rowHeight);
+	}
+
+	// the wheel pushes the physics, instead of chesto's own wheel handling
+	if (event->isScroll())
+		scroll.fling(event->wheelScroll * SCROLL_WHEEL_SPEED);
+	event->wheelScroll = 0;
+
+	// touch drags still move the list directly, the physics keeps up for when it's let go
+	int before = this->y;
+	bool ret = ListElement::process(event);
+	if (this->y != before)
+		scroll.drag(this->y);
+	if (event->isTouchUp())
+		scroll.release();
+
+	if (scroll.step())
+	{
+		this->y = scroll.offset();
+		ret = true;
+	}
+
+	scrolledTo = this->y;
+	return ret;
+}
+
+bool AppList::processCards(InputEvents* event)
+{
+	bool ret = false;
+
+	int first, last;
+	visibleCards(&first, &last, CARD_ROWS_AHEAD);
+
+	if (!event->isTouch())
+	{
+		for (int x = first; x < last; x++)
+			ret |= appCards[x].process(event);
+		return ret;
+	}
+
+	// icons still start loading as a touch scrolls the list
+	for (int x = first; x < last; x++)
+		appCards[x].handleIconLoad();
+
+	int hit = cardAt(event->xPos, event->yPos);
+	if (hit >= 0)
+		ret |= appCards[hit].process(event);
+
+	// the card the touch started on hears about it moving away, or lifting
+	if (touchedCard >= 0 && touchedCard != hit && touchedCard < totalCount)
+		ret |= appCards[touchedCard].process(event);
+
+	if (event->isTouchDown())
+		touchedCard = hit;
+	else if (event->isTouchUp())
+		touchedCard = -1;
+
+	return ret;
+}
+
+bool AppList::sortCompare(int sortMode, const Package& left, const Package& right)
 {
 	// handle the supported sorting modes
 	switch (sortMode)
@@ -361,61 +495,115 @@ void AppList::update()
 	if (!get)
 		return;
 
-#if defined(_3DS) || defined(_3DS_MOCK)
-  R = 3;  // force 3 app cards at time
-  this->x = 45; // no sidebar
-#endif
-	// remove elements
-	super::removeAll();
+	needsUpdate = false;
 
-	// destroy old elements
-	appCards.clear();
+	// which packages to show is worked out in the background, the old cards stay up meanwhile
+	std::string category = sidebar->currentCatValue();
+	std::string query = sidebar->searchQuery;
+	int sort = sortMode;
+	int generation = ++queryGeneration;
+
+	BackgroundJobs::jobs->run([this, category, query, sort, generation]() -> std::function<void()> {
+		int updates = 0;
+		auto packages = std::make_shared<std::vector<Package>>(queryPackages(category, query, sort, &updates));
 
-	// the current category value from the sidebar
-	std::string curCategoryValue = sidebar->currentCatValue();
+		return [this, category, packages, updates, generation] {
+			// a newer query is on its way
+			if (generation != queryGeneration)
+				return;
+
+			// the app cards can't be rebuilt under an open details screen, which points into them
+			if (RootDisplay::subscreen)
+			{
+				needsUpdate = true;
+				return;
+			}
+
+			rebuild(category, *packages, updates);
+		};
+	});
+}
+
+std::vector<Package> AppList::queryPackages(const std::string& category, const std::string& query, int sort, int* updates)
+{
+	// background operations reload package statuses under this
+	std::lock_guard<std::mutex> getGuard(OperationQueue::getLock);
 
 	// all packages TODO: move some of this filtering logic into main get library
 	// if it's a search, do a search query through get rather than using all packages
-	auto packages = (curCategoryValue == "_search")
-		? get->search(sidebar->searchQuery)
+	auto packages = (category == "_search")
+		? get->search(query)
 		: get->list();
 
+	// count the updates across every category, for the update all button
+	// (updating ourselves needs platform specific steps, so that's left to its details page)
+	*updates = 0;
+	for (auto &package : get->list())
+		*updates += package.getStatus() == UPDATE && package.getPackageName() != APP_SHORTNAME;
+
 	// sort the packages
-	if (sortMode == RANDOM)
+	if (sort == RANDOM)
 		std::shuffle(packages.begin(), packages.end(), randDevice);
 	else
-		std::sort(packages.begin(), packages.end(), std::bind(&AppList::sortCompare, this, std::placeholders::_1, std::placeholders::_2));
+		std::sort(packages.begin(), packages.end(), std::bind(&AppList::sortCompare, sort, std::placeholders::_1, std::placeholders::_2));
 
-	// add AppCards for the packages belonging to the current category
+	// keep the packages belonging to the current category
+	std::vector<Package> shown;
 	for (auto &package : packages)
 	{
-		if (curCategoryValue == "_misc")
+		if (category == "_misc")
 		{
 			// if we're on misc, filter out packages belonging to some category
 			if (std::find(std::begin(sidebar->cat_value), std::end(sidebar->cat_value), package.getCategory()) != std::end(sidebar->cat_value))
 				continue;
 		}
-		else if (curCategoryValue != "_all" && curCategoryValue != "_search")
+		else if (category != "_all" && category != "_search")
 		{
 			// if we're in a specific category, filter out package of different categories
-			if (curCategoryValue != package.getCategory())
+			if (category != package.getCategory())
 				continue;
 		}
 
-		if (curCategoryValue == "_all")
+		if (category == "_all")
 		{
 			// hide themes from all
 			if (package.getCategory() == "theme")
 			continue;
 		}
 
-		// create and position the AppCard for the package
+		shown.push_back(package);
+	}
+
+	return shown;
+}
+
+void AppList::rebuild(const std::string& curCategoryValue, std::vector<Package>& packages, int updates)
+{
+	FrameStats::Timer timer(STAT_LIST_REBUILD);
+
+#if defined(_3DS) || defined(_3DS_MOCK)
+  R = 3;  // force 3 app cards at time
+  this->x = 45; // no sidebar
+#endif
+	// remove elements
+	super::removeAll();
+
+	// destroy old elements
+	cardRows.clear();
+	appCards.clear();
+	touchedCard = -1;
+	hover.reset();
+
+	updateCount = updates;
+
+	// create and position the AppCards
+	for (auto &package : packages)
+	{
 		appCards.emplace_back(package, this);
 		AppCard& card = appCards.back();
 		card.index = appCards.size() - 1;
-		card.position(25 + (card.index % R) * (card.width + 9 / SCALER), 145 + (card.height + 15) * (card.index / R));
+		placeCard(card);
 		card.update();
-		super::append(&card);
 	}
 	totalCount = appCards.size();
 
@@ -451,7 +639,18 @@ void AppList::update()
 		// add additional buttons
 		creditsBtn.position(quitBtn.x - 20 - creditsBtn.width, quitBtn.y);
 		super::append(&creditsBtn);
-		sortBtn.position(creditsBtn.x - 20 - sortBtn.width, quitBtn.y);
+
+		// only offered when there's something to update
+		Element* rightOfSort = &creditsBtn;
+		if (updateCount > 0)
+		{
+			updateAllBtn.updateText((i18n("listing.updateall") + " (" + std::to_string(updateCount) + ")").c_str());
+			updateAllBtn.position(creditsBtn.x - 20 - updateAllBtn.width, quitBtn.y);
+			super::append(&updateAllBtn);
+			rightOfSort = &updateAllBtn;
+		}
+
+		sortBtn.position(rightOfSort->x - 20 - sortBtn.width, quitBtn.y);
 		super::append(&sortBtn);
 	
 
@@ -521,15 +720,18 @@ void AppList::update()
 	// now playing text (or applet warning)
 	super::append(&nowPlayingText);
 #endif
+}
 
-	needsUpdate = false;
+void AppList::placeCard(AppCard& card)
+{
+	card.position(CARDS_LEFT + (card.index % R) * (card.width + CARD_GAP_X), CARDS_TOP + (card.height + CARD_GAP_Y) * (card.index / R));
 }
 
 void AppList::reorient()
 {
-	// remove a highilight if it exists (TODO: extract method, we use this everywehre)
-	if (this->highlighted >= 0 && this->highlighted < this->elements.size() && this->elements[this->highlighted])
-		this->elements[this->highlighted]->elasticCounter = NO_HIGHLIGHT;
+	// remove a highlight if it exists
+	if (this->highlighted >= 0 && this->highlighted < totalCount)
+		appCards[this->highlighted].elasticCounter = NO_HIGHLIGHT;
 }
 
 void AppList::keyboardInputCallback()
@@ -576,6 +778,23 @@ void AppList::toggleAudio()
 #endif
 }
 
+void AppList::updateAll()
+{
+	if (!OperationQueue::queue)
+		return;
+
+	std::vector<Package> updates;
+	{
+		std::lock_guard<std::mutex> getGuard(OperationQueue::getLock);
+		for (auto &package : get->list())
+			if (package.getStatus() == UPDATE && package.getPackageName() != APP_SHORTNAME)
+				updates.push_back(package);
+	}
+
+	// downloaded concurrently, then installed one at a time, in the background
+	OperationQueue::queue->enqueueBatch(updates);
+}
+
 void AppList::toggleKeyboard()
 {
 	reorient();
@@ -10,10 +10,14 @@
 
 #include "AppCard.hpp"
 #include "AppDetails.hpp"
+#include "CardRows.hpp"
+#include "HoverPrefetch.hpp"
+#include "ScrollPhysics.hpp"
 #include "Sidebar.hpp"
 
+#include <deque>
+#include <memory>
 #include <random>
-#include <list>
 
 #define TOTAL_SORTS 5 // alphabetical (with updates at top), downloads, last updated, size, shuffled
 #define RECENT 0
@@ -24,6 +28,18 @@
 
 #define PANE_WIDTH SCREEN_HEIGHT
 
+// where the grid of app cards starts within the list, and the gaps between cards
+#define CARDS_LEFT 25
+#define CARDS_TOP 145
+#define CARD_GAP_X (9 / SCALER)
+#define CARD_GAP_Y 15
+
+// how close (in px) the cursor's card can get to the top or bottom edge before the list scrolls
+#define SCROLL_EDGE 20
+
+// rows above and below the screen that are still processed, so their icons start loading early
+#define CARD_ROWS_AHEAD 1
+
 class AppList : public ListElement
 {
 public:
@@ -40,6 +56,7 @@ public:
 	void cycleSort();
 	void reorient();
 	void toggleAudio();
+	void updateAll();
 
 	bool touchMode = true;
 	bool needsUpdate = false;
@@ -47,6 +64,9 @@ public:
 	// the total number of apps displayed in this list
 	int totalCount = 0;
 
+	// packages (in any category) that have an update available
+	int updateCount = 0;
+
 	// default number of items per row TODO: save this value as config
 	int R = 3;
 
@@ -58,11 +78,36 @@ public:
 	EKeyboard keyboard;
 
 private:
-	bool sortCompare(const Package& left, const Package& right);
+	static bool sortCompare(int sortMode, const Package& left, const Package& right);
+
+	// the packages a category (or search) shows in this sort order, and how many updates there
+	// are overall, runs on the background jobs thread
+	std::vector<Package> queryPackages(const std::string& category, const std::string& query, int sort, int* updates);
+
+	// makes the cards for the queried packages, and lays out the rest of the list around them
+	void rebuild(const std::string& curCategoryValue, std::vector<Package>& packages, int updates);
+
+	// puts a card in its spot in the grid of R columns
+	void placeCard(AppCard& card);
+
+	// bumped for every query, so only the latest one's results are shown
+	int queryGeneration = 0;
 	std::random_device randDevice;
 
 	void keyboardInputCallback();
 
+	// the cards [first, last) in the rows on screen, plus this many more above and below
+	void visibleCards(int* first, int* last, int rowsAhead = 0);
+
+	// index of the card under this point on screen, -1 if there's none
+	int cardAt(int x, int y);
+
+	// only the cards around the screen see events, and touches only the card they're on
+	bool processCards(InputEvents* event);
+
+	// runs chesto's list handling (touch drags) with the wheel and flings going through scroll
+	bool processScroll(InputEvents* event);
+
 	// the title of this category (from the sidebar)
 	static CST_Color black, gray, red, lighterRed;
 	static std::string sortingDescriptions[TOTAL_SORTS];
@@ -72,6 +117,7 @@ private:
 	Button quitBtn;
 	Button creditsBtn;
 	Button sortBtn;
+	Button updateAllBtn;
 	Button keyboardBtn;
 	Button backspaceBtn;
 	TextElement nowPlayingText;
@@ -84,6 +130,20 @@ private:
 	std::vector<std::string> musicInfo;
 #endif
 
-	// list of visible app cards
-	std::list<AppCard> appCards;
+	// the app cards in the current category, in grid order (they aren't children of the list)
+	std::deque<AppCard> appCards;
+
+	// the card a touch started on, it gets the rest of that touch too
+	int touchedCard = -1;
+
+	// the rows of cards on screen, drawn once and copied while scrolling
+	CardRows cardRows;
+
+	// the list's scroll offset, and the last one it set (anything else moved the list)
+	ScrollPhysics scroll;
+	int scrolledTo = 0;
+
+	// details of the card the cursor rests on, and the way it was last moving (in cards)
+	HoverPrefetch hover;
+	int travel = 1;
 };
@@ -0,0 +1,93 @@
+#include "BackgroundJobs.hpp"
+
+#include "FramePacer.hpp"
+
+BackgroundJobs* BackgroundJobs::jobs = nullptr;
+
+void BackgroundJobs::init()
+{
+	if (!jobs)
+		jobs = new BackgroundJobs();
+}
+
+void BackgroundJobs::quit()
+{
+	delete jobs;
+	jobs = nullptr;
+}
+
+BackgroundJobs::BackgroundJobs()
+{
+	thread = std::thread(&BackgroundJobs::worker, this);
+}
+
+BackgroundJobs::~BackgroundJobs()
+{
+	// jobs that haven't started are dropped, a running one is waited for
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+		pending.clear();
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+void BackgroundJobs::run(std::function<std::function<void()>()> work)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending.push_back(work);
+	}
+	wake.notify_all();
+}
+
+bool BackgroundJobs::deliver()
+{
+	std::vector<std::function<void()>> done;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		done.swap(finished);
+	}
+
+	for (auto& result : done)
+		result();
+
+	return !done.empty();
+}
+
+bool BackgroundJobs::idle()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return pending.empty() && !busy && finished.empty();
+}
+
+void BackgroundJobs::worker()
+{
+	while (true)
+	{
+		std::function<std::function<void()>()> work;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return stopping || !pending.empty(); });
+			if (stopping)
+				break;
+
+			work = pending.front();
+			pending.pop_front();
+			busy = true;
+		}
+
+		auto result = work();
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (result)
+				finished.push_back(result);
+			busy = false;
+		}
+
+		// the main loop may be idling, it has something to pick up now
+		FramePacer::wake();
+	}
+}
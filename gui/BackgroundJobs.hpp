@@ -0,0 +1,48 @@
+#ifndef BACKGROUNDJOBS_H_
+#define BACKGROUNDJOBS_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Moves slow work (querying and sorting packages, reading files) off the main thread, which
+// does input, layout and drawing. A job's work runs on the worker thread, in the order jobs
+// were started, and returns what to do with its result. That part runs back on the main
+// thread from MainDisplay::process, where elements and textures can be touched safely.
+class BackgroundJobs
+{
+public:
+	static BackgroundJobs* jobs;
+
+	static void init();
+	static void quit();
+
+	// work runs on the worker, the function it returns runs on the main thread
+	void run(std::function<std::function<void()>()> work);
+
+	// runs what finished jobs handed back, on the main thread, returns whether there was any
+	bool deliver();
+
+	// nothing is waiting, running, or waiting to be delivered
+	bool idle();
+
+private:
+	BackgroundJobs();
+	~BackgroundJobs();
+
+	void worker();
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::thread thread;
+	bool stopping = false;
+	bool busy = false;
+
+	std::deque<std::function<std::function<void()>()>> pending;
+	std::vector<std::function<void()>> finished;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "CardRows.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "../libs/chesto/src/RootDisplay.hpp"
+
+#include "AppList.hpp"
+#include "ThemeManager.hpp"
+
+void CardRows::clear()
+{
+	rows.clear();
+}
+
+bool CardRows::draw(RenderTarget& row, std::deque<AppCard>& cards, int start, int end, int width)
+{
+	// the list's background is solid, so rows are drawn over it and copied without blending
+	if (!row.begin(width, cards[start].height, HBAS::ThemeManager::background))
+		return false;
+
+	// stands in for the list, placed so the row's first card lands on the texture's corner
+	Element origin;
+	origin.x = -cards[start].x;
+	origin.y = -cards[start].y;
+
+	for (int x = start; x < end; x++)
+	{
+		// the cursor's highlight animates, it's drawn live instead
+		int highlight = cards[x].elasticCounter;
+		cards[x].elasticCounter = NO_HIGHLIGHT;
+		cards[x].render(&origin);
+		cards[x].elasticCounter = highlight;
+	}
+
+	row.end();
+	return true;
+}
+
+void CardRows::render(Element* list, std::deque<AppCard>& cards, int R, int first, int last)
+{
+	if (first >= last)
+		return;
+
+	int firstRow = first / R;
+	int lastRow = (last - 1) / R;
+
+	// rows scrolled well away are let go, the ones just off screen are kept for scrolling back
+	for (auto row = rows.begin(); row != rows.end();)
+	{
+		if (row->first < firstRow - CARD_ROWS_AHEAD || row->first > lastRow + CARD_ROWS_AHEAD)
+			row = rows.erase(row);
+		else
+			row++;
+	}
+
+	int width = R * (cards.front().width + CARD_GAP_X);
+
+	for (int row = firstRow; row <= lastRow; row++)
+	{
+		int start = row * R;
+		int end = std::min(start + R, (int)cards.size());
+
+		// a row with an icon still on its way would be cached without it
+		bool complete = RenderTarget::supported;
+		for (int x = start; x < end && complete; x++)
+			complete = cards[x].iconFetch && cards[x].icon.loaded;
+
+		auto cached = rows.find(row);
+		if (complete && cached == rows.end())
+		{
+			cached = rows.emplace(std::piecewise_construct, std::forward_as_tuple(row), std::forward_as_tuple()).first;
+			if (!draw(cached->second, cards, start, end, width))
+			{
+				rows.erase(cached);
+				complete = false;
+			}
+		}
+
+		if (!complete)
+		{
+			for (int x = start; x < end; x++)
+				cards[x].render(list);
+			continue;
+		}
+
+		// the whole row is one copy, moved by however far the list is scrolled
+		cached->second.render(list->x + cards[start].x, list->y + cards[start].y);
+
+		for (int x = start; x < end; x++)
+			if (cards[x].elasticCounter != NO_HIGHLIGHT)
+				cards[x].render(list);
+	}
+}
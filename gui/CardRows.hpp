@@ -0,0 +1,31 @@
+#ifndef CARDROWS_H_
+#define CARDROWS_H_
+
+#include <deque>
+#include <map>
+
+#include "AppCard.hpp"
+#include "RenderTarget.hpp"
+
+// Keeps each row of app cards on screen drawn into its own texture, so a frame where the list
+// only scrolled copies a handful of textures at the new offset instead of walking every card's
+// elements. A row is drawn again only after the cards are rebuilt, and rows still waiting on
+// an icon, as well as the highlighted card, are drawn live on top.
+class CardRows
+{
+public:
+	// the cards were rebuilt or moved, nothing cached matches anymore
+	void clear();
+
+	// draws the cards [first, last), which make up whole rows of R
+	void render(Element* list, std::deque<AppCard>& cards, int R, int first, int last);
+
+private:
+	// draws the cards [start, end) into a row's texture, false if that isn't supported
+	bool draw(RenderTarget& row, std::deque<AppCard>& cards, int start, int end, int width);
+
+	// textures by row number, only for the rows around the screen
+	std::map<int, RenderTarget> rows;
+};
+
+#endif
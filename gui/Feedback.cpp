@@ -4,10 +4,7 @@
 
 #include "../libs/chesto/src/RootDisplay.hpp"
 
-#ifndef NETWORK_MOCK
-#include <curl/curl.h>
-#include <curl/easy.h>
-#endif
+#include "../core/ConnectionPool.hpp"
 
 Feedback::Feedback(Package& package)
 	: package(&package)
@@ -101,10 +98,6 @@ void Feedback::keyboardInputCallback()
 
 void Feedback::submit()
 {
-#ifndef NETWORK_MOCK
-	CURL* curl;
-	CURLcode res;
-
 #if defined(__WIIU__)
 	const char* userKey = "wiiu_user";
 #elif defined(WII)
@@ -113,19 +106,8 @@ void Feedback::submit()
 	const char* userKey = "switch_user";
 #endif
 
-	curl = curl_easy_init();
-	if (curl)
-	{
-		curl_easy_setopt(curl, CURLOPT_URL, "http://switchbru.com/appstore/feedback");
-		std::string fields = std::string("name=") + userKey + "&package=" + package->getPackageName() + "&message=" + keyboard.getTextInput();
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, fields.c_str());
-
-		res = curl_easy_perform(curl);
-
-		/* always cleanup */
-		curl_easy_cleanup(curl);
-	}
-#endif
+	std::string fields = std::string("name=") + userKey + "&package=" + package->getPackageName() + "&message=" + keyboard.getTextInput();
+	ConnectionPool::pool->post("http://switchbru.com/appstore/feedback", fields);
 
 	// close this window
 	this->back();
@@ -14,11 +14,7 @@
 #include "../libs/chesto/src/Container.hpp"
 #include "../libs/chesto/src/DrawUtils.hpp"
 
-
-#ifndef NETWORK_MOCK
-#include <curl/curl.h>
-#include <curl/easy.h>
-#endif
+#include "../core/ConnectionPool.hpp"
 
 using namespace rapidjson;
 
@@ -103,14 +99,10 @@ FeedbackCenter::FeedbackCenter(AppList* appList)
     ListElement* list = new ListElement();
 
 #ifndef NETWORK_MOCK
-	CURL* curl;
-	CURLcode res;
-	curl = curl_easy_init();
-	if (curl)
 	{
         // TODO: get previously submitted IDs from local store
 		std::string resp;
-        downloadFileToMemory(MESSAGES_URL "?ids=8975,8974,8969,8951,8940,8957,8956", &resp);
+        ConnectionPool::pool->fetch(MESSAGES_URL "?ids=8975,8974,8969,8951,8940,8957,8956", &resp);
         
 		Document doc;
         ParseResult ok = doc.Parse(resp.c_str());
@@ -142,7 +134,6 @@ FeedbackCenter::FeedbackCenter(AppList* appList)
         }
 
         child(list);
-		curl_easy_cleanup(curl);
 	}
 
 #endif
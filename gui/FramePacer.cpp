@@ -0,0 +1,76 @@
+#include "FramePacer.hpp"
+
+#include "../libs/chesto/src/DrawUtils.hpp"
+
+int FramePacer::cap = FRAME_RATE_CAP;
+uint32_t FramePacer::lastFrame = 0;
+bool FramePacer::animating = false;
+
+void FramePacer::frame()
+{
+	if (cap > 0)
+	{
+		int wait = (int)(lastFrame + 1000 / cap - CST_GetTicks());
+		if (wait > 0)
+			CST_Delay(wait);
+	}
+
+	lastFrame = CST_GetTicks();
+}
+
+void FramePacer::idle(bool busy)
+{
+	// the next animation frame or finished download is never more than a few ticks away
+	busy |= animating;
+	animating = false;
+	if (busy)
+		return;
+
+	int wait = IDLE_TICK_MS - 1000 / 60;
+
+	// returns as soon as an event is queued, without taking it off the queue
+	// (the main loop still waits out a normal frame after this)
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	SDL_WaitEventTimeout(NULL, wait);
+#else
+	// sdl 1.2 can't wait with a timeout, so peek at the queue every few ms instead
+	SDL_Event event;
+	uint32_t until = CST_GetTicks() + wait;
+	SDL_PumpEvents();
+	while (CST_GetTicks() < until && SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_ALLEVENTS) <= 0)
+	{
+		CST_Delay(IDLE_POLL_MS);
+		SDL_PumpEvents();
+	}
+#endif
+}
+
+void FramePacer::wake()
+{
+	// any event ends the wait, input handling ignores this one
+	// (sdl 1.2 and 2 both allow pushing one from another thread)
+	SDL_Event event = {};
+	event.type = SDL_USEREVENT;
+	SDL_PushEvent(&event);
+}
+
+bool FramePacer::animate(uint32_t* lastStep)
+{
+	animating = true;
+
+	uint32_t step = CST_GetTicks() / ANIMATION_FRAME_MS;
+	if (step == *lastStep)
+		return false;
+
+	*lastStep = step;
+	return true;
+}
+
+double FramePacer::now()
+{
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency() * 1000;
+#else
+	return CST_GetTicks();
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef FRAMEPACER_H_
+#define FRAMEPACER_H_
+
+#include <cstdint>
+
+// most frames drawn per second
+#if defined(_3DS) || defined(_3DS_MOCK)
+#define FRAME_RATE_CAP 30
+#else
+#define FRAME_RATE_CAP 60
+#endif
+
+// how long (in ms) an idle main loop goes between ticks, unless input or finished work wakes it
+#define IDLE_TICK_MS 100
+
+// how often (in ms) an idle loop checks for input where SDL can't wait with a timeout
+#define IDLE_POLL_MS 5
+
+// how often (in ms) something animating as it's drawn (like the cursor's highlight) gets a new frame
+#define ANIMATION_FRAME_MS 33
+
+// Paces the main loop. While the screen is changing (scrolling, animations, downloads) frames
+// are drawn as fast as they come, up to the platform's cap. Once a tick has nothing to draw
+// the loop only ticks every IDLE_TICK_MS, which is enough for timers like the prefetch
+// dwell, and sleeps in between until there's input or background work finishes.
+class FramePacer
+{
+public:
+	// most frames per second, 0 for no cap
+	static int cap;
+
+	// call right before drawing, waits out whatever is left of the last frame under the cap
+	static void frame();
+
+	// call when a tick had nothing to draw, sleeps until the next tick or a wake()
+	// (unless something is animating or downloading, then the loop keeps ticking)
+	static void idle(bool busy = false);
+
+	// call from process() while an element animates as it's drawn, true when it's due a new
+	// frame, lastStep is the element's own (0 to start with)
+	static bool animate(uint32_t* lastStep);
+
+	// wakes an idle loop right away, safe to call from any thread
+	static void wake();
+
+	// ms since startup, finer than a ms where SDL has a performance counter (not 1.2)
+	static double now();
+
+private:
+	static uint32_t lastFrame;
+	static bool animating;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "../libs/chesto/src/RootDisplay.hpp"
+
+#include "FramePacer.hpp"
+
+FrameStats* FrameStats::stats = nullptr;
+bool FrameStats::comboHeld = false;
+
+static const char* statNames[STAT_COUNT] = {
+	"AppList process",
+	"AppList render",
+	"AppCard process",
+	"AppCard render",
+	"Sidebar process",
+	"Sidebar render",
+	"AppDetailsContent process",
+	"AppDetailsContent render",
+	"texture upload",
+	"text render",
+	"list rebuild",
+	"network callback",
+};
+
+static CST_Color statsText = { 0xff, 0xff, 0xff, 0xff };
+
+bool FrameStats::combo(InputEvents* event)
+{
+	// events come one button at a time, so the held half of the combo is tracked here
+	if (event->isKeyDown() && event->held(ZR_BUTTON))
+		comboHeld = true;
+	else if (event->isKeyUp() && event->released(ZR_BUTTON))
+		comboHeld = false;
+
+	return comboHeld && event->isKeyDown() && event->pressed(Y_BUTTON);
+}
+
+void FrameStats::toggle()
+{
+	if (stats)
+	{
+		delete stats;
+		stats = nullptr;
+		return;
+	}
+
+	stats = new FrameStats();
+}
+
+FrameStats::FrameStats()
+	: summary(" ", 15, &statsText, MONOSPACED, 380)
+{
+}
+
+FrameStats::Timer::Timer(int stat)
+	: stat(stat)
+{
+	if (FrameStats::stats)
+		start = FramePacer::now();
+}
+
+FrameStats::Timer::~Timer()
+{
+	// the overlay may have been turned on or off in between
+	if (FrameStats::stats && start)
+		FrameStats::stats->spent[stat] += FramePacer::now() - start;
+}
+
+double FrameStats::budget()
+{
+	return 1000.0 / (FramePacer::cap > 0 ? FramePacer::cap : 60);
+}
+
+int FrameStats::slowest(int from, int to)
+{
+	int found = from;
+	for (int x = from; x < to; x++)
+		if (spent[x] > spent[found])
+			found = x;
+	return found;
+}
+
+void FrameStats::frame()
+{
+	double now = FramePacer::now();
+
+	// the time since the last frame started, everything in the buckets happened in it
+	if (frameStart)
+	{
+		double ms = now - frameStart;
+		history[next] = ms;
+		next = (next + 1) % FRAME_HISTORY;
+		count = std::min(count + 1, FRAME_HISTORY);
+
+		if (ms > budget() * HITCH_FACTOR)
+		{
+			int cause = slowest(STAT_ELEMENTS, STAT_COUNT);
+			int element = slowest(0, STAT_ELEMENTS);
+			printf("--> Slow frame: %.1fms, %s %.1fms, slowest element %s %.1fms\n", ms,
+				spent[cause] >= 1 ? statNames[cause] : "unattributed", spent[cause], statNames[element], spent[element]);
+		}
+	}
+
+	std::copy(spent, spent + STAT_COUNT, last);
+	std::fill(spent, spent + STAT_COUNT, 0);
+	frameStart = now;
+}
+
+void FrameStats::idle()
+{
+	std::fill(spent, spent + STAT_COUNT, 0);
+	frameStart = 0;
+}
+
+void FrameStats::updateSummary()
+{
+	std::vector<double> sorted(history, history + count);
+	std::sort(sorted.begin(), sorted.end());
+
+	auto percentile = [&sorted](double p) {
+		return sorted.empty() ? 0 : sorted[(int)(p * (sorted.size() - 1))];
+	};
+
+	char line[128];
+	snprintf(line, sizeof(line), "p50 %.1f  p90 %.1f  p99 %.1f  max %.1f ms",
+		percentile(0.5), percentile(0.9), percentile(0.99), percentile(1));
+	std::string text = line;
+
+	// the three slowest element subtrees of the last frame
+	std::vector<int> order;
+	for (int x = 0; x < STAT_ELEMENTS; x++)
+		order.push_back(x);
+	std::sort(order.begin(), order.end(), [this](int a, int b) { return last[a] > last[b]; });
+
+	for (int x = 0; x < 3; x++)
+	{
+		snprintf(line, sizeof(line), "\n%-26s %5.2f ms", statNames[order[x]], last[order[x]]);
+		text += line;
+	}
+
+	summary.setText(text);
+	summary.update();
+}
+
+void FrameStats::render(Element* parent)
+{
+	const int barWidth = 3;
+	const int graphHeight = 100;
+	int left = SCREEN_WIDTH - FRAME_HISTORY * barWidth - 20;
+	int top = 20;
+
+	if (CST_GetTicks() - summaryAt > STATS_TEXT_INTERVAL)
+	{
+		summaryAt = CST_GetTicks();
+		updateSummary();
+	}
+
+	CST_Rect panel = { left - 10, top - 10, FRAME_HISTORY * barWidth + 20, graphHeight + summary.height + 30 };
+	CST_SetDrawBlend(RootDisplay::renderer, true);
+	CST_SetDrawColorRGBA(RootDisplay::renderer, 0x00, 0x00, 0x00, 0xc0);
+	CST_FillRect(RootDisplay::renderer, &panel);
+
+	// one bar per frame, oldest on the left, 2px per ms
+	double budgetMs = budget();
+	for (int x = 0; x < count; x++)
+	{
+		double ms = history[(next - count + x + FRAME_HISTORY) % FRAME_HISTORY];
+		int height = std::min((int)(ms * 2), graphHeight);
+
+		if (ms <= budgetMs)
+			CST_SetDrawColorRGBA(RootDisplay::renderer, 0x40, 0xd0, 0x40, 0xff);
+		else if (ms <= budgetMs * HITCH_FACTOR)
+			CST_SetDrawColorRGBA(RootDisplay::renderer, 0xe0, 0xc0, 0x30, 0xff);
+		else
+			CST_SetDrawColorRGBA(RootDisplay::renderer, 0xe0, 0x40, 0x40, 0xff);
+
+		CST_Rect bar = { left + x * barWidth, top + graphHeight - height, barWidth - 1, height };
+		CST_FillRect(RootDisplay::renderer, &bar);
+	}
+
+	// the frame budget
+	CST_Rect line = { left, top + graphHeight - (int)(budgetMs * 2), FRAME_HISTORY * barWidth, 1 };
+	CST_SetDrawColorRGBA(RootDisplay::renderer, 0xff, 0xff, 0xff, 0x80);
+	CST_FillRect(RootDisplay::renderer, &line);
+
+	summary.position(left, top + graphHeight + 10);
+	summary.render(parent);
+}
@@ -0,0 +1,90 @@
+#ifndef FRAMESTATS_H_
+#define FRAMESTATS_H_
+
+#include "../libs/chesto/src/InputEvents.hpp"
+#include "../libs/chesto/src/TextElement.hpp"
+
+// element subtrees, timings include their children
+#define STAT_APPLIST_PROCESS 0
+#define STAT_APPLIST_RENDER 1
+#define STAT_APPCARD_PROCESS 2
+#define STAT_APPCARD_RENDER 3
+#define STAT_SIDEBAR_PROCESS 4
+#define STAT_SIDEBAR_RENDER 5
+#define STAT_DETAILS_PROCESS 6
+#define STAT_DETAILS_RENDER 7
+#define STAT_ELEMENTS 8
+
+// the usual causes of a hitch, these can overlap the element timings
+#define STAT_TEXTURE_UPLOAD 8
+#define STAT_TEXT_RENDER 9
+#define STAT_LIST_REBUILD 10
+#define STAT_NETWORK 11
+#define STAT_COUNT 12
+
+// how many frame times the graph shows
+#define FRAME_HISTORY 120
+
+// a frame taking this many times the frame rate cap's frame time gets logged
+#define HITCH_FACTOR 1.5
+
+// how often (in ms) the overlay's summary text is redone, it costs a text render itself
+#define STATS_TEXT_INTERVAL 500
+
+// Debug overlay, toggled by holding ZR and pressing Y. It graphs recent frame times, shows
+// their percentiles and the element subtrees that took the longest last frame. While it's
+// on, every frame over budget is logged with what most of its time went to.
+class FrameStats
+{
+public:
+	// nullptr while the overlay is off, so the timers cost next to nothing
+	static FrameStats* stats;
+
+	// whether this event completes the toggle combo
+	static bool combo(InputEvents* event);
+	static void toggle();
+
+	// adds the time until it goes out of scope to one of the STAT_ buckets
+	class Timer
+	{
+	public:
+		Timer(int stat);
+		~Timer();
+
+	private:
+		int stat;
+		double start = 0;
+	};
+
+	// call at the start of every drawn frame
+	void frame();
+
+	// call when a tick draws nothing, the time until the next frame isn't a frame time
+	void idle();
+
+	void render(Element* parent);
+
+private:
+	FrameStats();
+
+	double budget();
+	int slowest(int from, int to);
+	void updateSummary();
+
+	static bool comboHeld;
+
+	// ms spent per bucket since the current frame started, and during the last one
+	double spent[STAT_COUNT] = {};
+	double last[STAT_COUNT] = {};
+
+	// ring of the latest frame times in ms
+	double history[FRAME_HISTORY] = {};
+	int next = 0;
+	int count = 0;
+
+	double frameStart = 0;
+	int summaryAt = 0;
+	TextElement summary;
+};
+
+#endif
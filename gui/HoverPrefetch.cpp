@@ -0,0 +1,104 @@
+#include "HoverPrefetch.hpp"
+
+#include "../libs/chesto/src/NetImageElement.hpp"
+#include "../libs/chesto/src/TextElement.hpp"
+
+#include "../core/ConnectionPool.hpp"
+
+#include "AppDetailsContent.hpp"
+#include "AppList.hpp"
+#include "FrameStats.hpp"
+#include "ThemeManager.hpp"
+
+HoverPrefetch::~HoverPrefetch()
+{
+	for (auto& entry : warmed)
+		for (auto asset : entry.assets)
+			delete asset;
+}
+
+void HoverPrefetch::reset()
+{
+	restingOn.clear();
+	done = false;
+}
+
+void HoverPrefetch::update(Package* highlighted, const std::vector<Package*>& ahead, bool useBannerIcons)
+{
+	if (!highlighted)
+	{
+		reset();
+		return;
+	}
+
+	// the cursor moved, wait for it to settle
+	if (highlighted->getPackageName() != restingOn)
+	{
+		restingOn = highlighted->getPackageName();
+		restingSince = CST_GetTicks();
+		done = false;
+		return;
+	}
+
+	if (done || CST_GetTicks() - restingSince < HOVER_DWELL_MS)
+		return;
+
+	// speculative, so it waits for a downloading install like the pool's prefetches do
+	if (ConnectionPool::pool && ConnectionPool::pool->installing())
+		return;
+	done = true;
+
+	warm(highlighted, true, useBannerIcons);
+	for (auto package : ahead)
+		warm(package, false, useBannerIcons);
+}
+
+void HoverPrefetch::warm(Package* package, bool full, bool useBannerIcons)
+{
+	std::string name = package->getPackageName();
+
+	// already warm, just keep it around longer (a neighbour can still need its text)
+	for (auto entry = warmed.begin(); entry != warmed.end(); entry++)
+	{
+		if (entry->name != name)
+			continue;
+
+		if (!full || entry->full)
+		{
+			warmed.splice(warmed.begin(), warmed, entry);
+			return;
+		}
+
+		for (auto asset : entry->assets)
+			delete asset;
+		warmed.erase(entry);
+		break;
+	}
+
+	Warmed entry { name, full, {} };
+
+	// same urls as AppDetailsContent, so its images come out of the cache
+	{
+		FrameStats::Timer timer(STAT_TEXTURE_UPLOAD);
+		entry.assets.push_back(new NetImageElement(useBannerIcons ? package->getBannerUrl().c_str() : package->getIconUrl().c_str()));
+		if (useBannerIcons && package->getScreenshotCount() > 0)
+			entry.assets.push_back(new NetImageElement(package->getScreenShotUrl(1).c_str()));
+	}
+
+	// laid out (and cached) exactly like the page's description, which costs the most to render
+	if (full)
+	{
+		FrameStats::Timer timer(STAT_TEXT_RENDER);
+		entry.assets.push_back(new TextElement(getTrimmedDetails(nullptr, package->getLongDescription()).c_str(),
+			20 / SCALER, &HBAS::ThemeManager::textPrimary, false, PANE_WIDTH + 20 / SCALER));
+	}
+
+	warmed.push_front(entry);
+
+	while (warmed.size() > HOVER_WARM_MAX)
+	{
+		for (auto asset : warmed.back().assets)
+			delete asset;
+		warmed.pop_back();
+	}
+}
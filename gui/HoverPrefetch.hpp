@@ -0,0 +1,55 @@
+#ifndef HOVERPREFETCH_H_
+#define HOVERPREFETCH_H_
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "../libs/get/src/Package.hpp"
+
+#include "../libs/chesto/src/Element.hpp"
+
+// how long (in ms) the cursor has to rest on a card before its details are warmed up
+#define HOVER_DWELL_MS 250
+
+// cards past the highlighted one, in the direction the cursor was moving, that get warmed too
+#define HOVER_LOOKAHEAD 2
+
+// most packages kept warm at once, the least recently warmed are let go
+#define HOVER_WARM_MAX 12
+
+// Loads what the details page of a package shows first (its banner, first screenshot and
+// description text) while the cursor is still resting on its card in the list, so pressing
+// A opens a page that's already complete. The images go through the same url cache the page
+// uses, and the description is laid out with the same text settings, so the page just picks
+// them up. The neighbours in the direction of travel only get their images fetched.
+class HoverPrefetch
+{
+public:
+	~HoverPrefetch();
+
+	// call every frame with the highlighted card's package (or nullptr) and the ones ahead of it
+	void update(Package* highlighted, const std::vector<Package*>& ahead, bool useBannerIcons);
+
+	// the list was rebuilt, whatever was highlighted is gone
+	void reset();
+
+private:
+	struct Warmed
+	{
+		std::string name;
+		bool full;
+		std::vector<Element*> assets;
+	};
+
+	void warm(Package* package, bool full, bool useBannerIcons);
+
+	std::string restingOn;
+	int restingSince = 0;
+	bool done = false;
+
+	// most recently warmed at the front
+	std::list<Warmed> warmed;
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "InputReplay.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "../libs/chesto/src/RootDisplay.hpp"
+
+#include "FramePacer.hpp"
+
+InputReplay* InputReplay::replay = nullptr;
+
+// what the events look like on ticks where nothing is replayed
+static void clearEvent(InputEvents* event)
+{
+	event->noop = true;
+	event->type = 0;
+	event->keyCode = -1;
+	event->isScrolling = false;
+	event->wheelScroll = 0;
+}
+
+InputReplay::InputReplay()
+{
+}
+
+InputReplay::~InputReplay()
+{
+	if (file)
+		fclose(file);
+}
+
+bool InputReplay::record(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		printf("--> Couldn't record input to %s\n", path.c_str());
+		return false;
+	}
+
+	fprintf(file, "# ticks type keyCode xPos yPos isScrolling wheelScroll\n");
+	fprintf(file, "scenario recorded\n");
+
+	quit();
+	replay = new InputReplay();
+	replay->file = file;
+	return true;
+}
+
+bool InputReplay::play(const std::string& path)
+{
+	std::ifstream input(path);
+	if (!input.is_open())
+	{
+		printf("--> Couldn't replay input from %s\n", path.c_str());
+		return false;
+	}
+
+	auto loaded = new InputReplay();
+	loaded->playing = true;
+
+	int events = 0;
+	int scenarios = 0;
+	std::string line;
+	while (std::getline(input, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		Step step;
+		if (line.rfind("scenario ", 0) == 0)
+		{
+			std::string keyword;
+			fields >> keyword >> step.scenario;
+			loaded->steps.push_back(step);
+			scenarios++;
+			continue;
+		}
+
+		if (!(fields >> step.ticks >> step.type >> step.keyCode >> step.xPos >> step.yPos >> step.isScrolling >> step.wheelScroll))
+		{
+			printf("--> Skipping unreadable replay line: %s\n", line.c_str());
+			continue;
+		}
+
+		loaded->steps.push_back(step);
+		events++;
+	}
+
+	// a recording without any scenario lines is a single one
+	if (scenarios == 0)
+	{
+		Step step;
+		step.scenario = "replay";
+		loaded->steps.insert(loaded->steps.begin(), step);
+		scenarios++;
+	}
+
+	printf("--> Replaying %d events in %d scenarios from %s\n", events, scenarios, path.c_str());
+
+	quit();
+	replay = loaded;
+	return true;
+}
+
+void InputReplay::headless()
+{
+	// SDL's dummy video driver has no window
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+#else
+	SDL_putenv((char*)"SDL_VIDEODRIVER=dummy");
+#endif
+}
+
+void InputReplay::quit()
+{
+	if (!replay)
+		return;
+
+	if (replay->playing && !replay->finished)
+		replay->summarize();
+
+	delete replay;
+	replay = nullptr;
+}
+
+void InputReplay::start()
+{
+	if (started)
+		return;
+
+	started = true;
+	lastTick = ticks;
+}
+
+void InputReplay::event(InputEvents* event, bool listReady, bool loaded)
+{
+	if (!playing)
+	{
+		if (started && !event->noop)
+		{
+			fprintf(file, "%d %d %d %d %d %d %g\n", ticks - lastTick, event->type, event->keyCode, event->xPos, event->yPos, event->isScrolling, event->wheelScroll);
+			lastTick = ticks;
+		}
+		return;
+	}
+
+	// real input never gets through while replaying
+	clearEvent(event);
+	if (!started || finished)
+		return;
+
+	// a scenario starts from a fully loaded list, whatever the one before it left going
+	while (next < steps.size() && !steps[next].scenario.empty())
+	{
+		if (!listReady || !loaded)
+			return;
+
+		summarize();
+		scenario = steps[next++].scenario;
+		lastTick = ticks;
+	}
+
+	if (next >= steps.size())
+	{
+		if (loaded && ticks - lastTick >= REPLAY_TAIL_TICKS)
+		{
+			summarize();
+			finished = true;
+			RootDisplay::mainDisplay->requestQuit();
+		}
+		return;
+	}
+
+	// at most one per tick, and never against a list that's still being queried
+	auto& step = steps[next];
+	if (ticks - lastTick < step.ticks || !listReady)
+		return;
+
+	next++;
+	lastTick = ticks;
+
+	event->noop = false;
+	event->type = step.type;
+	event->keyCode = step.keyCode;
+	event->xPos = step.xPos;
+	event->yPos = step.yPos;
+	event->isScrolling = step.isScrolling;
+	event->wheelScroll = step.wheelScroll;
+}
+
+void InputReplay::idle()
+{
+	ticks++;
+	idling = playing;
+}
+
+void InputReplay::summarize()
+{
+	// frames before the first scenario (the initial load) aren't part of any
+	if (scenario.empty() || frames.empty())
+	{
+		frames.clear();
+		return;
+	}
+
+	std::sort(frames.begin(), frames.end());
+	auto percentile = [this](double p) {
+		return frames[(int)(p * (frames.size() - 1))];
+	};
+
+	int slow = 0;
+	double budget = FramePacer::cap > 0 ? 1000.0 / FramePacer::cap : 1000.0 / 60;
+	for (double frame : frames)
+		slow += frame > budget;
+
+	printf("--> Scenario %s: %d frames, p50 %.2f p90 %.2f p99 %.2f max %.2f ms, %d over %.1f ms\n",
+		scenario.c_str(), (int)frames.size(), percentile(0.5), percentile(0.9), percentile(0.99), percentile(1), slow, budget);
+
+	bool header = !std::ifstream(REPLAY_STATS_PATH).good();
+	FILE* stats = fopen(REPLAY_STATS_PATH, "a");
+	if (stats)
+	{
+		if (header)
+			fprintf(stats, "scenario,frames,p50,p90,p99,max,over_budget\n");
+		fprintf(stats, "%s,%d,%.3f,%.3f,%.3f,%.3f,%d\n",
+			scenario.c_str(), (int)frames.size(), percentile(0.5), percentile(0.9), percentile(0.99), percentile(1), slow);
+		fclose(stats);
+	}
+
+	frames.clear();
+}
+
+InputReplay::Timer::Timer(bool endsFrame)
+	: endsFrame(endsFrame)
+{
+	if (replay && replay->playing)
+		start = FramePacer::now();
+}
+
+InputReplay::Timer::~Timer()
+{
+	if (!replay)
+		return;
+
+	// drawn frames count as ticks while recording too
+	if (endsFrame)
+		replay->ticks++;
+
+	if (!start)
+		return;
+
+	// the tick drew nothing, so its work doesn't count towards the next frame
+	if (replay->idling)
+	{
+		replay->idling = false;
+		replay->pending = 0;
+		return;
+	}
+
+	replay->pending += FramePacer::now() - start;
+	if (endsFrame)
+	{
+		replay->frames.push_back(replay->pending);
+		replay->pending = 0;
+	}
+}
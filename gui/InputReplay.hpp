@@ -0,0 +1,106 @@
+#ifndef INPUTREPLAY_H_
+#define INPUTREPLAY_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../libs/chesto/src/InputEvents.hpp"
+
+// where each replayed scenario's frame time summary is appended, as csv
+#define REPLAY_STATS_PATH "./replay_stats.csv"
+
+// how many ticks a replay keeps going after its last event before it quits
+#define REPLAY_TAIL_TICKS 60
+
+// Records every input event to a text file, with how many main loop ticks (drawn frames and
+// idle ticks) came before it, and plays such a file back in place of real input (which is
+// ignored while it runs). Events are replayed by tick rather than by time, and only once
+// the list has caught up with the background jobs, so a slower build gets the same inputs
+// against the same states as a faster one.
+//
+// A recording can be split into scenarios by adding "scenario <name>" lines between its
+// events. Each scenario only starts once everything (the list and its images) has loaded,
+// and its frame times (process and render work, without the pacer's sleeps) are summarized
+// on stdout and appended to REPLAY_STATS_PATH. The app quits once the replay is over.
+class InputReplay
+{
+public:
+	// recording or replaying, nullptr otherwise
+	static InputReplay* replay;
+
+	// start recording into, or replaying, this file (false if it can't be opened or read)
+	static bool record(const std::string& path);
+	static bool play(const std::string& path);
+
+	// draw without a window, has to be called before the display is created
+	static void headless();
+
+	// flushes a recording, and writes out the scenario a replay was in the middle of
+	static void quit();
+
+	// the app list came up, ticks count from the first call
+	void start();
+
+	// call with every event before anything else looks at it, it's either recorded or replaced
+	// with the next recorded one (or nothing). listReady is whether the list has caught up with
+	// every background job, loaded whether its images are done downloading too
+	void event(InputEvents* event, bool listReady, bool loaded);
+
+	// call when a tick draws nothing, the work it did isn't part of a frame
+	void idle();
+
+	// adds the time until it goes out of scope to the current frame, and ends the frame
+	// if it's the one around rendering
+	class Timer
+	{
+	public:
+		Timer(bool endsFrame = false);
+		~Timer();
+
+	private:
+		bool endsFrame;
+		double start = 0;
+	};
+
+private:
+	InputReplay();
+	~InputReplay();
+
+	// an event, or the start of a scenario if that's set
+	struct Step
+	{
+		std::string scenario;
+		int ticks = 0;
+		int type = 0;
+		int keyCode = -1;
+		int xPos = 0;
+		int yPos = 0;
+		bool isScrolling = false;
+		float wheelScroll = 0;
+	};
+
+	void summarize();
+
+	// the file being recorded to
+	FILE* file = nullptr;
+
+	// ticks since startup, and when the last event was recorded or replayed
+	int ticks = 0;
+	int lastTick = 0;
+	bool started = false;
+
+	// what's being replayed, and how far along it is
+	bool playing = false;
+	std::vector<Step> steps;
+	size_t next = 0;
+	bool finished = false;
+
+	// the scenario being replayed and its frame times in ms
+	std::string scenario;
+	std::vector<double> frames;
+	double pending = 0;
+	bool idling = false;
+};
+
+#endif
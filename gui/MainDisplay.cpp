@@ -4,18 +4,32 @@
 #if defined(WII)
 #include <ogc/conf.h>
 #endif
+#include <cmath>
 #include <filesystem>
 #include <unordered_set>
 #include "../libs/get/src/Get.hpp"
 #include "../libs/get/src/Utils.hpp"
 #include "../libs/chesto/src/Constraint.hpp"
-
+#include "../libs/chesto/src/DownloadQueue.hpp"
+
+#include "../core/ConnectionPool.hpp"
+#include "../core/InstallJournal.hpp"
+#include "../core/InstalledDB.hpp"
+#include "../core/PackagePrefetch.hpp"
+#include "../core/OperationQueue.hpp"
+
+#include "BackgroundJobs.hpp"
+#include "FramePacer.hpp"
+#include "FrameStats.hpp"
+#include "InputReplay.hpp"
 #include "MainDisplay.hpp"
 #include "ThemeManager.hpp"
 #include "main.hpp"
 
 using namespace std::string_literals; // for ""s
 
+bool MainDisplay::damaged = false;
+
 MainDisplay::MainDisplay()
 	: RootDisplay(), appList(NULL, &sidebar)
 {
@@ -29,6 +43,14 @@ MainDisplay::MainDisplay()
 
 	updateSidebarColor();
 
+	// status of the background install/remove queue, shown while it's busy
+	queueProgress.width = 400;
+	queueProgress.position(SCREEN_WIDTH - queueProgress.width - 40, SCREEN_HEIGHT - 25);
+	queueProgress.color = 0xff0000ff;
+	queueStatus.setSize(18);
+	queueStatus.setColor(HBAS::ThemeManager::textPrimary);
+	queueStatus.position(queueProgress.x, SCREEN_HEIGHT - 60);
+
 	#if defined(WII)
 		if(CONF_GetAspectRatio() == CONF_ASPECT_16_9)
 			setScreenResolution(854, 480);
@@ -42,6 +64,9 @@ void MainDisplay::updateSidebarColor() {
 	// set the background color (used as sidebar color)
 	auto color = HBAS::ThemeManager::sidebarColor;
 	backgroundColor = fromRGB(color.r, color.g, color.b);
+
+	// the sidebar's cached layer was drawn with the old theme
+	sidebar.invalidate();
 }
 
 void MainDisplay::setupMusic() {
@@ -90,13 +115,125 @@ void MainDisplay::playSFX()
 
 MainDisplay::~MainDisplay()
 {
+	// a repo load still going is cut short at its next transfer callback
+	stopLoading = true;
+	if (loader.joinable())
+		loader.join();
+
+	// stop the background operations before the get instance they use goes away
+	BackgroundJobs::quit();
+	PackagePrefetch::quit();
+	OperationQueue::quit();
+	InstalledDB::quit();
 	delete get;
 	delete spinner;
 }
 
-void MainDisplay::beginInitialLoad() {
-	networking_callback = nullptr;
+void MainDisplay::loadRepos()
+{
+	// fetch repositories metadata
+#if defined(WII)
+	// default the repo type to OSC for wii
+	get = new Get(DEFAULT_GET_HOME, DEFAULT_REPO, false, "osc");
+#else
+	get = new Get(DEFAULT_GET_HOME, DEFAULT_REPO, false);
+#endif
+
+	// an install or removal the console powered off during is finished (or undone) before statuses load
+	auto recovered = InstallJournal::recover(get);
+
+	// what's installed, without reading every package folder
+	InstalledDB::init(get);
+	for (auto& name : recovered)
+		InstalledDB::db->refresh(name);
+
+	// update active repos according to the metarepo
+	online = checkMetaRepoForUpdates(get);
+
+	// actually download the repos
+	get->update();
+	auto removed = InstallJournal::finishRemovals(get);
+	for (auto& name : removed)
+		InstalledDB::db->erase(name);
+
+	// the statuses loaded above still had them installed
+	if (!removed.empty())
+		get->update();
+
+	// go through all repos and if one has an error, set the error flag
+	for (auto repo : get->getRepos())
+	{
+		error = error || !repo->isLoaded();
+		atLeastOneEnabled = atLeastOneEnabled || repo->isEnabled();
+	}
+
+	loadDone = true;
+	FramePacer::wake();
+}
+
+bool MainDisplay::finishInitialLoad()
+{
+	if (!online)
+	{
+		std::string connTestMsg = replaceAll(i18n("errors.conntest"), "PLATFORM", PLATFORM);
+		RootDisplay::switchSubscreen(new ErrorScreen(i18n("errors.nowifi"), connTestMsg + "\n" + i18n("errors.dnsmsg") + " " + META_REPO));
+		return true;
+	}
+
+	if (!atLeastOneEnabled)
+	{
+		RootDisplay::switchSubscreen(new ErrorScreen(i18n("errors.noserver"), i18n("errors.norepos") + "\n" + i18n("errors.onepkg")));
+		return true;
+	}
+
+	// sd card write test, try to open a file on the sd root
+	std::string tmp_dir = get->mTmp_path;
+	std::string tmp_file = tmp_dir + "write_test.txt";
+
+	bool writeFailed = false;
+	std::string magic = "Whosoever holds this hammer, if they be worthy, shall possess the power of Thor.";
+
+	// try to write to the file (no append)
+	std::ofstream file(tmp_file);
+	if (file.is_open()) {
+		file << magic;
+		file.close();
+	}
+	else writeFailed = true;
 	
+	// try to read from the file
+	std::ifstream read_file(tmp_file);
+	if (!writeFailed && read_file.is_open()) 
+	{
+		std::string line;
+		std::getline(read_file, line);
+		read_file.close();
+
+		if (line != magic) writeFailed = true;
+
+		// delete the file
+		std::remove(tmp_file.c_str());
+	}
+	else writeFailed = true;
+
+	if (writeFailed) {
+		std::string cardText = replaceAll(i18n("errors.writetestfail"), "PATH", tmp_file) + "\n";
+#if defined(__WIIU__)
+		cardText = i18n("errors.sdlock") + "\n"s + cardText;
+#elif defined (SWITCH)
+		cardText = i18n("errors.exfat") + "\n"s + cardText;
+#endif
+
+		RootDisplay::switchSubscreen(new ErrorScreen(i18n("errors.sdaccess"), cardText));
+		return true;
+	}
+
+	beginInitialLoad();
+
+	return true;
+}
+
+void MainDisplay::beginInitialLoad() {
 	if (spinner) {
 		// remove spinner
 		super::remove(spinner);
@@ -104,6 +241,14 @@ void MainDisplay::beginInitialLoad() {
 		spinner = nullptr;
 	}
 
+	// installs and removals run in the background from here on
+	OperationQueue::init(get);
+	OperationQueue::queue->onFinished = FramePacer::wake;
+	PackagePrefetch::init(get);
+
+	// the app list queries its packages on here
+	BackgroundJobs::init();
+
 	// set get instance to our applist
 	appList.get = get;
 	appList.update();
@@ -113,7 +258,7 @@ void MainDisplay::beginInitialLoad() {
 bool MainDisplay::checkMetaRepoForUpdates(Get* get) {
 	// download the metarepo (+1 network call)
 	std::string data("");
-	bool success = downloadFileToMemory(META_REPO "/index.json", &data);
+	bool success = ConnectionPool::pool->fetch(META_REPO "/index.json", &data, PRIORITY_BACKGROUND);
 
 	if (!success) {
 		// couldn't download the metarepo, so just return
@@ -197,12 +342,32 @@ void MainDisplay::render(Element* parent)
 	if (showingSplash)
 		renderedSplash = true;
 
+	FramePacer::frame();
+	InputReplay::Timer replayTimer(true);
+	if (FrameStats::stats)
+		FrameStats::stats->frame();
+
 	renderBackground(true);
 	RootDisplay::render(parent);
+
+	// background operation progress, over the app list
+	if (showingQueue && !RootDisplay::subscreen)
+	{
+		queueStatus.render(this);
+		queueProgress.render(this);
+	}
+
+	if (FrameStats::stats)
+		FrameStats::stats->render(this);
 }
 
 bool MainDisplay::process(InputEvents* event)
 {
+	// a recording sees every event first, a replay swaps them for the recorded ones
+	if (InputReplay::replay)
+		InputReplay::replay->event(event, listReady(), listReady() && imageDownloads == 0);
+	InputReplay::Timer replayTimer;
+
 	if (!RootDisplay::subscreen && showingSplash && renderedSplash && event->noop)
 	{
 		showingSplash = false;
@@ -229,119 +394,161 @@ bool MainDisplay::process(InputEvents* event)
 		spinner->position(SCREEN_WIDTH / 2 - spinner->width / 2, 70);
 #endif
 
-		networking_callback = MainDisplay::updateLoader;
-
-		// fetch repositories metadata
-#if defined(WII)
-		// default the repo type to OSC for wii
-		get = new Get(DEFAULT_GET_HOME, DEFAULT_REPO, false, "osc");
-#else
-		get = new Get(DEFAULT_GET_HOME, DEFAULT_REPO, false);
-#endif
-
-		// update active repos according to the metarepo
-		bool isOnline = checkMetaRepoForUpdates(get);
-
-		// actually download the repos
-		get->update();
-
-		// go through all repos and if one has an error, set the error flag
-		for (auto repo : get->getRepos())
-		{
-			error = error || !repo->isLoaded();
-			atLeastOneEnabled = atLeastOneEnabled || repo->isEnabled();
-		}
+		// repos are fetched on another thread, while the spinner keeps turning at the display's rate
+		networking_callback = MainDisplay::onLoadProgress;
+		loader = std::thread(&MainDisplay::loadRepos, this);
+		return true;
+	}
 
-		if (!isOnline)
+	if (loader.joinable())
+	{
+		if (!loadDone)
 		{
-			std::string connTestMsg = replaceAll(i18n("errors.conntest"), "PLATFORM", PLATFORM);
-			RootDisplay::switchSubscreen(new ErrorScreen(i18n("errors.nowifi"), connTestMsg + "\n" + i18n("errors.dnsmsg") + " " + META_REPO));
+			if (spinner)
+				spinner->angle = fmod(CST_GetTicks() * SPINNER_SPEED / 1000.0, 360);
 			return true;
 		}
 
-		if (!atLeastOneEnabled)
-		{
-			RootDisplay::switchSubscreen(new ErrorScreen(i18n("errors.noserver"), i18n("errors.norepos") + "\n" + i18n("errors.onepkg")));
-			return true;
-		}
+		loader.join();
+		networking_callback = nullptr;
+		return finishInitialLoad();
+	}
 
-		// sd card write test, try to open a file on the sd root
-		std::string tmp_dir = get->mTmp_path;
-		std::string tmp_file = tmp_dir + "write_test.txt";
+	// debug overlay with frame times, the combo's button press doesn't go any further
+	if (FrameStats::combo(event))
+	{
+		FrameStats::toggle();
+		return true;
+	}
 
-		bool writeFailed = false;
-		std::string magic = "Whosoever holds this hammer, if they be worthy, shall possess the power of Thor.";
+	updateQueueStatus();
 
-		// try to write to the file (no append)
-		std::ofstream file(tmp_file);
-		if (file.is_open()) {
-			file << magic;
-			file.close();
-		}
-		else writeFailed = true;
-		
-		// try to read from the file
-		std::ifstream read_file(tmp_file);
-		if (!writeFailed && read_file.is_open()) 
-		{
-			std::string line;
-			std::getline(read_file, line);
-			read_file.close();
+	// results of slow work that was done off this thread
+	if (BackgroundJobs::jobs && BackgroundJobs::jobs->deliver())
+	{
+		// recordings count time from when the first list came up
+		if (InputReplay::replay)
+			InputReplay::replay->start();
+		damage();
+	}
 
-			if (line != magic) writeFailed = true;
+	// the app cards can't be rebuilt under an open details screen, which points into them
+	if (appList.needsUpdate && !RootDisplay::subscreen)
+	{
+		appList.update();
+		damage();
+	}
 
-			// delete the file
-			std::remove(tmp_file.c_str());
-		}
-		else writeFailed = true;
-
-		if (writeFailed) {
-			std::string cardText = replaceAll(i18n("errors.writetestfail"), "PATH", tmp_file) + "\n";
-	#if defined(__WIIU__)
-			cardText = i18n("errors.sdlock") + "\n"s + cardText;
-	#elif defined (SWITCH)
-			cardText = i18n("errors.exfat") + "\n"s + cardText;
-	#endif
+	// if we need a redraw, also update the app list (for resizing events)
+	if (needsRedraw)
+	{
+		needsRedraw = false;
+		appList.update();
+		damage();
+	}
 
-			RootDisplay::switchSubscreen(new ErrorScreen(i18n("errors.sdaccess"), cardText));
-			return true;
-		}
+	// a finished download swaps an image in somewhere, without any input
+	// (this only advances transfers the main loop is running anyway)
+	int downloads = 0;
+	{
+		FrameStats::Timer timer(STAT_NETWORK);
+		downloads = DownloadQueue::downloadQueue ? DownloadQueue::downloadQueue->process() : 0;
+	}
+	if (downloads != imageDownloads)
+		damage();
+	imageDownloads = downloads;
 
-		beginInitialLoad();
+	// elements report their own changes (and animations still running) from process()
+	if (RootDisplay::process(event))
+		damage();
 
+	if (damaged)
+	{
+		damaged = false;
 		return true;
 	}
 
-	// if we need a redraw, also update the app list (for resizing events)
-	// TODO: have a more generalized way to have a view describe what needs redrawing
-	if (needsRedraw)
-		appList.update();
+	// the last frame drawn is still what's on screen, so don't draw it again,
+	// and sleep until there's input or something finishes in the background
+	if (FrameStats::stats)
+		FrameStats::stats->idle();
+	if (InputReplay::replay)
+		InputReplay::replay->idle();
+	// downloads are only advanced from here, so the loop doesn't sleep while there are any
+	FramePacer::idle(downloads > 0);
+	return false;
+}
 
-	return RootDisplay::process(event) || true;
+bool MainDisplay::listReady()
+{
+	return !showingSplash && !loader.joinable() && BackgroundJobs::jobs && BackgroundJobs::jobs->idle() && !appList.needsUpdate && !needsRedraw;
 }
 
-int MainDisplay::updateLoader(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow)
+void MainDisplay::damage()
 {
-	int now = CST_GetTicks();
-	int diff = now - AppDetails::lastFrameTime;
+	damaged = true;
+}
 
-	if (dltotal == 0) dltotal = 1;
+void MainDisplay::updateQueueStatus()
+{
+	auto queue = OperationQueue::queue;
+	if (!queue)
+		return;
 
-	double amount = dlnow / dltotal;
+	// packages that were installed or removed in the background changed status
+	for (auto& op : queue->takeFinished())
+	{
+		if (op.succeeded && op.quitAfter)
+			requestQuit();
+
+		if (op.kind != OP_VERIFY)
+			appList.needsUpdate = true;
+	}
+
+	// progress is published without locking, so this is cheap to check every frame
+	auto& progress = queue->progress;
+	int currentId = progress.currentId;
+	if (showingQueue != (currentId >= 0))
+		damage();
+	showingQueue = currentId >= 0;
+
+	if (!showingQueue)
+		return;
+
+	// the title only needs looking up once per operation
+	if (currentId != queueId)
+	{
+		queueId = currentId;
+		queueTitle = (progress.lastId != currentId) ? i18n("listing.updates") : queue->title(currentId);
+	}
 
-	// don't update the GUI too frequently here, it slows down downloading
-	// (never return early if it's 100% done)
-	if (diff < 32 && amount != 1)
-		return 0;
+	int64_t total = progress.bytesTotal;
+	double percent = total > 0 ? (double)progress.bytesNow / total : 0;
+	if (percent != queueProgress.percent)
+	{
+		queueProgress.percent = percent;
+		damage();
+	}
 
-	MainDisplay* display = (MainDisplay*)RootDisplay::mainDisplay;
-	if (display->spinner)
-		display->spinner->angle += 10;
-	display->render(NULL);
+	std::string text = AppDetails::statusText(progress.stage, queueTitle, progress.item, progress.itemTotal);
+	if (progress.pending > 0)
+		text += " " + replaceAll(i18n("listing.queued"), "COUNT", std::to_string(progress.pending));
 
-	AppDetails::lastFrameTime = CST_GetTicks();
+	if (text != queueText)
+	{
+		FrameStats::Timer timer(STAT_TEXT_RENDER);
+		queueText = text;
+		queueStatus.setText(text);
+		queueStatus.update();
+		damage();
+	}
+}
 
-	return 0;
+int MainDisplay::onLoadProgress(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow)
+{
+	// nothing to draw from here, just stop early if the app is closing
+	auto display = (MainDisplay*)RootDisplay::mainDisplay;
+	return display->stopLoading ? 1 : 0;
 }
 
 
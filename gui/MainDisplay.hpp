@@ -2,6 +2,8 @@
 #include "../libs/chesto/src/RootDisplay.hpp"
 #include "../libs/chesto/src/TextElement.hpp"
 #include "../libs/chesto/src/Button.hpp"
+#include <atomic>
+#include <thread>
 #include <unordered_map>
 
 #if defined(MUSIC)
@@ -27,6 +29,9 @@
 #define LOGO_PATH RAMFS "res/icon.png"
 #endif
 
+// how fast the loading spinner turns, in degrees per second
+#define SPINNER_SPEED 300
+
 class MainDisplay : public RootDisplay
 {
 public:
@@ -41,6 +46,12 @@ public:
 	void setupMusic();
 	void beginInitialLoad();
 
+	// fetches the repos and package statuses, on the loader thread
+	void loadRepos();
+
+	// shows an error screen if the load went wrong, or the app list otherwise
+	bool finishInitialLoad();
+
 	bool checkMetaRepoForUpdates(Get* get);
 	void updateSidebarColor();
 
@@ -49,7 +60,16 @@ public:
 	bool error = false;
 	bool atLeastOneEnabled = false;
 
-	static int updateLoader(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow);
+	static int onLoadProgress(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow);
+
+	// pick up finished background operations and refresh the queue progress
+	void updateQueueStatus();
+
+	// something on screen changed outside of any element's process(), the next tick draws
+	static void damage();
+
+	// the repos are loaded and the list has caught up with every query
+	bool listReady();
 
 	bool showingSplash = true;
 	bool renderedSplash = false;
@@ -64,6 +84,23 @@ public:
 private:
 	Sidebar sidebar;
 	AppList appList;
+
+	// the initial repo load, it only touches get and the core singletons until it's done
+	std::thread loader;
+	std::atomic<bool> loadDone { false };
+	std::atomic<bool> stopLoading { false };
+	bool online = false;
+
+	// whether this tick has something to draw, and how many images were downloading last tick
+	static bool damaged;
+	int imageDownloads = 0;
+
+	bool showingQueue = false;
+	int queueId = -1;
+	std::string queueTitle;
+	std::string queueText;
+	ProgressBar queueProgress;
+	TextElement queueStatus;
 };
 
 class ErrorScreen : public Element
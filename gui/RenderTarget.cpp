@@ -0,0 +1,73 @@
+#include "RenderTarget.hpp"
+
+#include "../libs/chesto/src/RootDisplay.hpp"
+
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+bool RenderTarget::supported = true;
+#else
+// sdl 1.2 only draws to the screen surface
+bool RenderTarget::supported = false;
+#endif
+
+RenderTarget::~RenderTarget()
+{
+	clear();
+}
+
+bool RenderTarget::begin(int width, int height, CST_Color background)
+{
+	clear();
+	if (!supported)
+		return false;
+
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	auto renderer = RootDisplay::renderer;
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+	previous = SDL_GetRenderTarget(renderer);
+	if (!texture || SDL_SetRenderTarget(renderer, texture) != 0)
+	{
+		printf("--> Can't draw into textures, drawing live instead\n");
+		clear();
+		supported = false;
+		return false;
+	}
+
+	this->width = width;
+	this->height = height;
+
+	// what's cached is copied without blending, so it starts out opaque
+	SDL_SetRenderDrawColor(renderer, background.r, background.g, background.b, 0xff);
+	SDL_RenderClear(renderer);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void RenderTarget::end()
+{
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	SDL_SetRenderTarget(RootDisplay::renderer, previous);
+#endif
+	previous = nullptr;
+}
+
+void RenderTarget::render(int x, int y)
+{
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	if (!texture)
+		return;
+
+	CST_Rect dest = { x, y, width, height };
+	SDL_RenderCopy(RootDisplay::renderer, texture, NULL, &dest);
+#endif
+}
+
+void RenderTarget::clear()
+{
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	if (texture)
+		SDL_DestroyTexture(texture);
+#endif
+	texture = nullptr;
+}
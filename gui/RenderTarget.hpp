@@ -0,0 +1,40 @@
+#ifndef RENDERTARGET_H_
+#define RENDERTARGET_H_
+
+#include "../libs/chesto/src/DrawUtils.hpp"
+
+// A texture that's drawn into once and then copied to the screen each frame, for parts of
+// the screen that rarely change. Drawing into textures needs SDL 2 and a renderer that
+// supports it; everywhere else begin() fails and the caller draws live instead.
+class RenderTarget
+{
+public:
+	RenderTarget() {}
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+	~RenderTarget();
+
+	// false once drawing into a texture has failed, so it isn't tried again
+	static bool supported;
+
+	// (re)creates the texture, cleared to background, and sends drawing to it until end()
+	bool begin(int width, int height, CST_Color background);
+	void end();
+
+	// copies the texture to the screen with its top left corner at x, y
+	void render(int x, int y);
+
+	// lets go of the texture
+	void clear();
+
+	bool ready() { return texture != nullptr; }
+
+	int width = 0;
+	int height = 0;
+
+private:
+	CST_Texture* texture = nullptr;
+	CST_Texture* previous = nullptr;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "ScrollPhysics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../libs/chesto/src/DrawUtils.hpp"
+
+void ScrollPhysics::setRows(int rowHeight, int lowest)
+{
+	this->rowHeight = std::max(rowHeight, 1);
+	this->lowest = std::min(lowest, 0);
+}
+
+double ScrollPhysics::clamp(double offset) const
+{
+	return std::max((double)lowest, std::min(offset, 0.0));
+}
+
+double ScrollPhysics::nearestRow(double offset) const
+{
+	return clamp(std::round(offset / rowHeight) * rowHeight);
+}
+
+void ScrollPhysics::jump(double offset)
+{
+	position = offset;
+	velocity = 0;
+	mode = SCROLL_IDLE;
+}
+
+void ScrollPhysics::scrollTo(double offset)
+{
+	target = clamp(offset);
+	if (mode == SCROLL_IDLE)
+		steppedAt = CST_GetTicks();
+	mode = SCROLL_GLIDE;
+}
+
+void ScrollPhysics::fling(double velocity)
+{
+	// a fling against the current motion stops it first
+	if (this->velocity * velocity < 0 || mode == SCROLL_GLIDE)
+		this->velocity = 0;
+
+	this->velocity += velocity;
+	if (mode == SCROLL_IDLE)
+		steppedAt = CST_GetTicks();
+	mode = SCROLL_COAST;
+}
+
+void ScrollPhysics::drag(double offset)
+{
+	int now = CST_GetTicks();
+
+	// smoothed, so one uneven touch sample doesn't decide the fling
+	if (mode == SCROLL_DRAG && now > draggedAt)
+		velocity = velocity * 0.5 + (offset - position) * 1000.0 / (now - draggedAt) * 0.5;
+	else if (mode != SCROLL_DRAG)
+		velocity = 0;
+
+	position = offset;
+	draggedAt = now;
+	mode = SCROLL_DRAG;
+}
+
+void ScrollPhysics::release()
+{
+	if (mode != SCROLL_DRAG)
+		return;
+
+	// the finger stopped before lifting, so there's nothing to carry on
+	if (CST_GetTicks() - draggedAt > 100)
+		velocity = 0;
+
+	steppedAt = CST_GetTicks();
+	mode = SCROLL_COAST;
+}
+
+bool ScrollPhysics::step()
+{
+	if (mode == SCROLL_IDLE || mode == SCROLL_DRAG)
+		return false;
+
+	int now = CST_GetTicks();
+	int steps = (now - steppedAt) / SCROLL_STEP_MS;
+	if (steps <= 0)
+		return false;
+
+	steppedAt += steps * SCROLL_STEP_MS;
+	steps = std::min(steps, SCROLL_MAX_STEPS);
+
+	int before = offset();
+	const double dt = SCROLL_STEP_MS / 1000.0;
+
+	for (int x = 0; x < steps && mode != SCROLL_IDLE; x++)
+	{
+		if (mode == SCROLL_COAST)
+		{
+			velocity -= velocity * SCROLL_FRICTION * dt;
+			position += velocity * dt;
+
+			// ran past either end, or slowed down enough to pick a row
+			if (position != clamp(position) || std::abs(velocity) < SCROLL_SNAP_SPEED)
+			{
+				target = nearestRow(position);
+				mode = SCROLL_GLIDE;
+			}
+		}
+		else if (mode == SCROLL_GLIDE)
+		{
+			double accel = SCROLL_SPRING * SCROLL_SPRING * (target - position) - 2 * SCROLL_SPRING * velocity;
+			velocity += accel * dt;
+			position += velocity * dt;
+
+			if (std::abs(target - position) < 0.5 && std::abs(velocity) < 5)
+			{
+				position = target;
+				velocity = 0;
+				mode = SCROLL_IDLE;
+			}
+		}
+	}
+
+	return offset() != before || mode != SCROLL_IDLE;
+}
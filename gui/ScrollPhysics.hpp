@@ -0,0 +1,70 @@
+#ifndef SCROLLPHYSICS_H_
+#define SCROLLPHYSICS_H_
+
+// length (in ms) of one simulation step, the same whatever the frame rate is
+#define SCROLL_STEP_MS 8
+
+// most steps caught up in one frame, after a stall the scroll just jumps ahead
+#define SCROLL_MAX_STEPS 12
+
+// how quickly a fling slows down, the fraction of velocity lost per second
+#define SCROLL_FRICTION 3.5
+
+// stiffness of the glide towards a target offset (critically damped, so it never overshoots)
+#define SCROLL_SPRING 18.0
+
+// below this speed (in px/s) a fling stops coasting and settles on the nearest row
+#define SCROLL_SNAP_SPEED 250.0
+
+// speed (in px/s) one notch of a mouse wheel adds
+#define SCROLL_WHEEL_SPEED 1200.0
+
+// Scroll offset of a list, simulated with velocity, friction and snapping to rows in fixed
+// steps, so it feels the same at any frame rate. A drag moves it directly and a release
+// keeps the finger's speed going as a fling; a fling coasts until it's slow, then glides onto
+// the nearest row. Offsets follow the list's convention: 0 at the top, negative scrolled down.
+class ScrollPhysics
+{
+public:
+	// rows are this far apart, and the offset can go from lowest up to 0
+	void setRows(int rowHeight, int lowest);
+
+	// jumps straight to an offset, stopping any motion
+	void jump(double offset);
+
+	// glides to an offset and settles exactly on it
+	void scrollTo(double offset);
+
+	// adds speed (in px/s, positive scrolls towards the top)
+	void fling(double velocity);
+
+	// the finger moved the list to this offset, its speed is kept for the release
+	void drag(double offset);
+	void release();
+
+	// runs the steps due since the last call, returns whether the offset changed
+	bool step();
+
+	int offset() const { return (int)(position + (position < 0 ? -0.5 : 0.5)); }
+	bool moving() const { return mode != SCROLL_IDLE; }
+
+private:
+	enum { SCROLL_IDLE, SCROLL_DRAG, SCROLL_COAST, SCROLL_GLIDE };
+
+	double clamp(double offset) const;
+	double nearestRow(double offset) const;
+
+	int mode = SCROLL_IDLE;
+	double position = 0;
+	double velocity = 0;
+	double target = 0;
+
+	int rowHeight = 1;
+	int lowest = 0;
+
+	// when the simulation was last stepped, and when the finger last moved
+	int steppedAt = 0;
+	int draggedAt = 0;
+};
+
+#endif
@@ -1,3 +1,4 @@
+#include "FrameStats.hpp"
 #include "MainDisplay.hpp"
 #include "../libs/chesto/src/Constraint.hpp"
 
@@ -119,10 +120,12 @@ void Sidebar::addHints()
 	hider->constrain(ALIGN_RIGHT | ALIGN_BOTTOM, 10);
 	hint->position(hider->x + hider->width + 5/SCALER, hider->y);
 	showCurrentCategory = true;
+	invalidate();
 }
 
 bool Sidebar::process(InputEvents* event)
 {
+	FrameStats::Timer timer(STAT_SIDEBAR_PROCESS);
 	bool ret = false;
 	int origHighlighted = highlighted;
 
@@ -237,21 +240,17 @@ bool Sidebar::process(InputEvents* event)
 
 void Sidebar::render(Element* parent)
 {
+	FrameStats::Timer timer(STAT_SIDEBAR_RENDER);
+
 #if defined(_3DS) || defined(_3DS_MOCK)
   // no sidebar on 3ds
   return;
 #endif
-	// draw the light gray bg behind the active category
 	CST_Rect dimens = { 0, 0, width, (int)(60/SCALER) }; // TODO: extract this to a method too
-	dimens.y = 150/SCALER + this->curCategory * 70/SCALER - 15 / SCALER;					   // TODO: extract formula into method
-
-	auto c = RootDisplay::mainDisplay->backgroundColor;
-	CST_Color consoleColor = { (int)(c.r * 255) + 0x25, (int)(c.g * 255) + 0x25, (int)(c.b * 255) + 0x25, 0xff };
-	// consoleColor.r = fmax(consoleColor.r, 0xff);
-	CST_SetDrawColor(RootDisplay::renderer, consoleColor);
 
-	if (this->showCurrentCategory)
-		CST_FillRect(RootDisplay::renderer, &dimens);
+	// everything but the highlights comes from one texture, if the renderer can draw to one
+	if (!renderLayer(parent))
+		renderStatic(parent);
 
 	if (appList && appList->touchMode && (this->currentSelection >= 0 && this->elasticCounter != THICK_HIGHLIGHT))
 	{
@@ -280,11 +279,62 @@ void Sidebar::render(Element* parent)
 			);
 		}
 	}
+}
+
+void Sidebar::renderStatic(Element* parent)
+{
+	// draw the light gray bg behind the active category
+	CST_Rect dimens = { 0, 0, width, (int)(60/SCALER) }; // TODO: extract this to a method too
+	dimens.y = 150/SCALER + this->curCategory * 70/SCALER - 15 / SCALER;					   // TODO: extract formula into method
+
+	auto c = RootDisplay::mainDisplay->backgroundColor;
+	CST_Color consoleColor = { (int)(c.r * 255) + 0x25, (int)(c.g * 255) + 0x25, (int)(c.b * 255) + 0x25, 0xff };
+	// consoleColor.r = fmax(consoleColor.r, 0xff);
+	CST_SetDrawColor(RootDisplay::renderer, consoleColor);
+
+	if (this->showCurrentCategory)
+		CST_FillRect(RootDisplay::renderer, &dimens);
 
 	// render subelements
 	super::render(parent);
 }
 
+bool Sidebar::renderLayer(Element* parent)
+{
+	if (!RenderTarget::supported)
+		return false;
+
+	// the category's name also changes with the language
+	auto c = RootDisplay::mainDisplay->backgroundColor;
+	std::string label = currentCatName();
+	bool stale = !layer.ready() || layer.width != width || layer.height != SCREEN_HEIGHT || layerLabel != label
+		|| layerShowsCategory != showCurrentCategory || layerColor.r != c.r || layerColor.g != c.g || layerColor.b != c.b;
+
+	if (stale)
+	{
+		// the sidebar sits right on the background, which is this solid color
+		CST_Color background = { (Uint8)(c.r * 255), (Uint8)(c.g * 255), (Uint8)(c.b * 255), 0xff };
+		if (!layer.begin(width, SCREEN_HEIGHT, background))
+			return false;
+
+		renderStatic(parent);
+		layer.end();
+
+		layerLabel = label;
+		layerShowsCategory = showCurrentCategory;
+		layerColor = c;
+	}
+
+	// anything drawn past the layer's width ends up under the app list anyway
+	layer.render(this->x, this->y);
+	return true;
+}
+
+void Sidebar::invalidate()
+{
+	layer.clear();
+}
+
 std::string Sidebar::currentCatName()
 {
 	if (this->curCategory >= 0 && this->curCategory < TOTAL_CATS)
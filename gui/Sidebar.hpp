@@ -2,6 +2,8 @@
 #include "../libs/chesto/src/ListElement.hpp"
 #include "../libs/chesto/src/TextElement.hpp"
 
+#include "RenderTarget.hpp"
+
 class AppList;
 
 #if defined(WII) || defined(WII_MOCK)
@@ -33,6 +35,9 @@ public:
 	void render(Element* parent);
 	bool process(InputEvents* event);
 
+	// the theme changed, so the cached layer is drawn again
+	void invalidate();
+
 	int currentSelection = -1;
 
 	bool showCurrentCategory = false;
@@ -62,6 +67,18 @@ private:
 
 	ImageElement* hider = nullptr;
 	TextElement* hint = nullptr;
+
+	// the active category's background and every element, without the highlights
+	void renderStatic(Element* parent);
+
+	// draws the static part from a cached texture, false if the renderer can't
+	bool renderLayer(Element* parent);
+
+	// the static part drawn once, and what it was drawn for
+	RenderTarget layer;
+	std::string layerLabel;
+	bool layerShowsCategory = false;
+	rgb layerColor = { 0, 0, 0 };
 };
 
 #if defined(USE_OSC_BRANDING)
@@ -27,9 +27,18 @@
 #include <unistd.h>
 #endif
 
+#include <filesystem>
+#include <fstream>
+
 #include "../libs/get/src/Get.hpp"
 #include "../libs/get/src/Utils.hpp"
 
+#include "../core/ConnectionPool.hpp"
+#include "../core/PackageInstaller.hpp"
+#include "../core/PackagePrefetch.hpp"
+#include "../core/RangeDownload.hpp"
+
+#include "InputReplay.hpp"
 #include "ThemeManager.hpp"
 #include "../gui/MainDisplay.hpp"
 
@@ -68,7 +77,22 @@ int main(int argc, char* argv[])
 	setPlatformPwd();
 #endif
 	init_networking();
-	setUserAgent("HBAS/" APP_VERSION " (" PLATFORM "; Chesto)");
+	std::string userAgent = "HBAS/" APP_VERSION " (" PLATFORM "; Chesto)";
+	setUserAgent(userAgent);
+
+	// one set of keep-alive connections and dns/tls caches for every request we make
+	ConnectionPool::init(userAgent);
+
+	// opt-in: split big package downloads into parallel byte ranges
+	if (std::filesystem::exists(SEGMENTED_PATH))
+		PackageInstaller::downloadSegments = DOWNLOAD_SEGMENTS;
+
+	// the prefetch cache's size in MB, 0 turns prefetching off
+	std::ifstream prefetchBudget(PREFETCH_PATH);
+	int megabytes = 0;
+	if (prefetchBudget >> megabytes)
+		PackagePrefetch::budget = megabytes > 0 ? (int64_t)megabytes * 1024 * 1024 : 0;
+
 	HBAS::ThemeManager::themeManagerInit();
 
 	bool cliMode = false;
@@ -77,9 +101,41 @@ int main(int argc, char* argv[])
 	cliMode = true;
 #endif
 	for (int x = 0; x < argc; x++)
-		if (std::string("--recovery") == argv[x])
+	{
+		std::string arg = argv[x];
+		if (arg == "--recovery")
 			cliMode = true;
 
+		// input recordings, to compare performance scenario by scenario (see InputReplay.hpp)
+		else if (arg == "--record" && x + 1 < argc)
+			InputReplay::record(argv[++x]);
+		else if (arg == "--replay" && x + 1 < argc)
+			InputReplay::play(argv[++x]);
+		else if (arg == "--headless")
+			InputReplay::headless();
+
+		// fetch one file the way packages are, and exit (see tools/test_downloads.sh)
+		else if (arg == "--download" && x + 2 < argc)
+		{
+			RangeDownload download(argv[x + 1], argv[x + 2], PackageInstaller::downloadSegments);
+			bool success = download.run();
+
+			ConnectionPool::quit();
+			deinit_networking();
+			return success ? 0 : 1;
+		}
+
+		// stream a zip into a folder the way packages are installed, and exit
+		else if (arg == "--extract" && x + 2 < argc)
+		{
+			bool success = PackageInstaller::extractUrl(argv[x + 1], argv[x + 2]);
+
+			ConnectionPool::quit();
+			deinit_networking();
+			return success ? 0 : 1;
+		}
+	}
+
 	// initialize main title screen
 	MainDisplay* display = new MainDisplay();
 	display->canUseSelectToExit = true;
@@ -118,6 +174,12 @@ int main(int argc, char* argv[])
 		display->mainLoop();
 	}
 
+	InputReplay::quit();
+
+	// stops the loader, the queues and the prefetcher, which all still use the pool
+	delete display;
+
+	ConnectionPool::quit();
 	deinit_networking();
 
 	return 0;
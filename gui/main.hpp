@@ -24,4 +24,6 @@
 
 // preference paths
 #define SOUND_PATH "./.toggle_sound"
+#define SEGMENTED_PATH "./.segmented_downloads"
+#define PREFETCH_PATH "./.prefetch_budget"
 #define DEFAULT_GET_HOME "./.get/"
\ No newline at end of file
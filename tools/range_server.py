@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+# A small HTTP server that serves the files in a folder with Range support, and can
+# misbehave in the ways package downloads have to survive. The first part of the path
+# picks how it behaves, e.g. http://localhost:8000/drop/big.zip serves ./big.zip:
+#   ok        answers ranges like a well behaved CDN
+#   drop      cuts the first response for each range start off halfway through
+#   dead      cuts every response off after DEAD_BYTES, so the download gives up
+#   overlong  answers ranges with DEAD_BYTES of junk past the end of what was asked for
+#   norange   ignores Range headers, and doesn't advertise them
+# usage: range_server.py <folder> [port]
+
+import os
+import re
+import sys
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+DEAD_BYTES = 256 * 1024
+CHUNK = 64 * 1024
+
+dropped = set()
+droppedLock = threading.Lock()
+
+
+class RangeHandler(BaseHTTPRequestHandler):
+	protocol_version = "HTTP/1.1"
+
+	def do_HEAD(self):
+		self.serve(False)
+
+	def do_GET(self):
+		self.serve(True)
+
+	def serve(self, body):
+		parts = self.path.strip("/").split("/", 1)
+		if len(parts) != 2:
+			return self.send_error(404)
+
+		mode, name = parts
+		path = os.path.join(folder, os.path.basename(name))
+		if mode not in ("ok", "drop", "dead", "overlong", "norange") or not os.path.isfile(path):
+			return self.send_error(404)
+
+		size = os.path.getsize(path)
+		start, end = 0, size
+
+		match = re.match(r"bytes=(\d+)-(\d*)$", self.headers.get("Range", ""))
+		ranged = match is not None and mode != "norange"
+		if ranged:
+			start = int(match.group(1))
+			if match.group(2):
+				end = min(size, int(match.group(2)) + 1)
+			if start >= end:
+				return self.send_error(416)
+
+		length = end - start
+		junk = DEAD_BYTES if mode == "overlong" and ranged else 0
+
+		self.send_response(206 if ranged else 200)
+		if mode != "norange":
+			self.send_header("Accept-Ranges", "bytes")
+		if ranged:
+			self.send_header("Content-Range", "bytes %d-%d/%d" % (start, end - 1, size))
+		self.send_header("Content-Length", str(length + junk))
+		self.end_headers()
+
+		if not body:
+			return
+
+		cut = None
+		if mode == "dead":
+			cut = DEAD_BYTES
+		elif mode == "drop":
+			with droppedLock:
+				if (name, start) not in dropped:
+					dropped.add((name, start))
+					cut = length // 2
+
+		sent = 0
+		with open(path, "rb") as file:
+			file.seek(start)
+			while sent < length:
+				data = file.read(min(CHUNK, length - sent))
+				if cut is not None and sent + len(data) > cut:
+					self.wfile.write(data[:cut - sent])
+					self.close_connection = True
+					return
+				self.wfile.write(data)
+				sent += len(data)
+
+		self.wfile.write(b"\xee" * junk)
+
+	def log_message(self, format, *args):
+		pass
+
+
+if __name__ == "__main__":
+	if len(sys.argv) < 2:
+		print("usage: range_server.py <folder> [port]")
+		sys.exit(1)
+
+	folder = sys.argv[1]
+	port = int(sys.argv[2]) if len(sys.argv) > 2 else 8000
+	ThreadingHTTPServer(("127.0.0.1", port), RangeHandler).serve_forever()
@@ -0,0 +1,108 @@
+#!/bin/bash
+# Runs package-style downloads (appstore.bin --download) against tools/range_server.py,
+# and checks each one ends up byte for byte the same as the file served. Then streams a
+# zip into a folder the way installs do (appstore.bin --extract) and checks the files.
+# usage: tools/test_downloads.sh [path to appstore.bin]
+
+APP=$(realpath "${1:-./appstore.bin}")
+TOOLS=$(dirname "$(realpath "$0")")
+PORT=8765
+WORK=$(mktemp -d)
+
+cleanup()
+{
+	kill $SERVER 2> /dev/null
+	rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# big enough to be split into segments
+mkdir -p "$WORK/served" "$WORK/plain" "$WORK/segmented"
+head -c $((20 * 1024 * 1024)) /dev/urandom > "$WORK/served/big.zip"
+ln -s big.zip "$WORK/served/plain.zip"
+ln -s big.zip "$WORK/served/segmented.zip"
+touch "$WORK/segmented/.segmented_downloads"
+
+# a package zip with stored and deflated files, big enough that a dropped connection cuts an entry in half
+python3 - "$WORK" << "ZIP"
+import os, sys, zipfile
+work = sys.argv[1]
+with zipfile.ZipFile(os.path.join(work, "served", "package.zip"), "w") as package:
+	package.writestr("switch/app/app.nro", os.urandom(3 * 1024 * 1024), zipfile.ZIP_STORED)
+	package.writestr("switch/app/data/", "")
+	package.writestr("switch/app/data/readme.txt", "hello\n" * 50000, zipfile.ZIP_DEFLATED)
+	package.writestr("manifest.install", "U: switch/app/app.nro\nU: switch/app/data/readme.txt\n", zipfile.ZIP_DEFLATED)
+	package.extractall(os.path.join(work, "expected"))
+ZIP
+
+python3 "$TOOLS/range_server.py" "$WORK/served" $PORT &
+SERVER=$!
+sleep 1
+
+FAILED=0
+
+# check <name> <folder> <mode> [mode to resume with]
+# each folder downloads its own name for the same file, so "drop" cuts off its requests too
+check()
+{
+	local name=$1 folder="$WORK/$2" mode=$3 resume=$4
+	rm -f "$folder"/big.zip*
+
+	local log
+	log=$(cd "$folder" && "$APP" --download "http://127.0.0.1:$PORT/$mode/$2.zip" big.zip)
+	if [ -n "$resume" ]; then
+		if [ ! -f "$folder/big.zip.part.ranges" ]; then
+			echo "FAIL $name: no progress was saved"
+			FAILED=1
+			return
+		fi
+		log=$(cd "$folder" && "$APP" --download "http://127.0.0.1:$PORT/$resume/$2.zip" big.zip)
+		if ! grep -q "Resuming" <<< "$log"; then
+			echo "FAIL $name: started over instead of resuming"
+			FAILED=1
+			return
+		fi
+	fi
+
+	if cmp -s "$WORK/served/big.zip" "$folder/big.zip"; then
+		echo "ok   $name"
+	else
+		echo "FAIL $name"
+		FAILED=1
+	fi
+}
+
+check "plain"                plain     ok
+check "plain, dropped"       plain     drop
+check "plain, restarted"     plain     dead ok
+check "plain, overlong"      plain     overlong
+check "plain, no ranges"     plain     norange
+check "segments"             segmented ok
+check "segments, dropped"    segmented drop
+check "segments, restarted"  segmented dead ok
+check "segments, overlong"   segmented overlong
+check "segments, no ranges"  segmented norange
+
+# extract <name> <mode>
+# the same streaming download an install does, resumed at the next byte the zip is waiting for
+extract()
+{
+	local name=$1 mode=$2
+	rm -rf "$WORK/extracted"
+
+	if ! "$APP" --extract "http://127.0.0.1:$PORT/$mode/package.zip" "$WORK/extracted" > /dev/null; then
+		echo "FAIL $name: didn't extract"
+		FAILED=1
+	elif diff -r "$WORK/expected" "$WORK/extracted" > /dev/null; then
+		echo "ok   $name"
+	else
+		echo "FAIL $name: extracted files differ"
+		FAILED=1
+	fi
+}
+
+extract "install"              ok
+extract "install, dropped"     drop
+extract "install, no ranges"   norange
+
+exit $FAILED